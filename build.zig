@@ -26,6 +26,7 @@ pub fn create_wasm_mod(
         .cpu_features_add = std.Target.wasm.featureSet(&.{
             .atomics,
             .bulk_memory,
+            .simd128,
         }),
         .os_tag = .emscripten,
     });
@@ -103,6 +104,7 @@ fn compile_dir_wasm(b: *Build,
         .cpu_features_add = std.Target.wasm.featureSet(&.{
             .atomics,
             .bulk_memory,
+            .simd128,
         }),
         .os_tag = .emscripten,
     });
@@ -195,6 +197,30 @@ fn compile_dir(
     }
 }
 
+// Native-only executables living in `src/tools`, run through their own build step with `-- <args>`.
+fn add_tool(
+    b: *std.Build,
+    step: *std.Build.Step,
+    target: std.Build.ResolvedTarget,
+    opt: std.builtin.OptimizeMode,
+    name: []const u8,
+    imports: []const std.Build.Module.Import) void {
+
+    const mod = b.createModule(.{
+        .root_source_file = b.path(b.fmt("src/tools/{s}.zig", .{name})),
+        .target = target,
+        .optimize = opt,
+        .imports = imports,
+    });
+    const exe = b.addExecutable(.{
+        .root_module = mod,
+        .name = b.fmt("zynth-{s}", .{name}),
+    });
+    const run = b.addRunArtifact(exe);
+    if (b.args) |args| run.addArgs(args);
+    step.dependOn(&run.step);
+}
+
 pub fn build(b: *std.Build) !void {
     const target = b.standardTargetOptions(.{});
     const opt = b.standardOptimizeOption(.{});
@@ -254,4 +280,29 @@ pub fn build(b: *std.Build) !void {
 
     try compile_dir(b, example_step, target, opt, "src/examples", enable_target_suffix, prefix_filter_opt, zynth, preset);
     if (enable_gui) try compile_dir(b, example_step, target, opt, "src/examples/gui", enable_target_suffix, prefix_filter_opt, zynth, preset);
+
+    const example_name = b.option([]const u8, "example", "the example whose `graph` is rendered by `render` (default: 00_sine_wave)") orelse "00_sine_wave";
+    const example = b.createModule(.{
+        .root_source_file = b.path(b.fmt("src/examples/{s}.zig", .{example_name})),
+        .target = target,
+        .optimize = opt,
+    });
+    example.addImport("zynth", zynth);
+    example.addImport("preset", preset);
+
+    const render_step = b.step("render", "render an example offline, faster than real time; pass options after `--`");
+    add_tool(b, render_step, target, opt, "render", &.{
+        .{ .name = "zynth", .module = zynth },
+        .{ .name = "example", .module = example },
+    });
+
+    const test_step = b.step("test", "run the unit tests of the zynth module");
+    const tests = b.addTest(.{ .root_module = zynth });
+    test_step.dependOn(&b.addRunArtifact(tests).step);
+
+    const bench_step = b.step("bench", "time every Streamer node across block sizes, as CSV; pass options after `--`");
+    add_tool(b, bench_step, target, opt, "bench", &.{
+        .{ .name = "zynth", .module = zynth },
+        .{ .name = "preset", .module = preset },
+    });
 }
@@ -0,0 +1,161 @@
+//! Additive synthesis: one node that sums up to hundreds of sine partials.
+//! Each partial is a unit phasor re + i·im, turned by its angle per sample with one complex multiply,
+//! so the inner loop has no `@sin`. Partials are stored as structure of arrays and stepped `VEC_LEN`
+//! at a time. Amplitudes are worked out once per block (control rate) and ramped linearly across it.
+const std = @import("std");
+
+const Streamer = @import("streamer.zig");
+const Config = @import("config.zig");
+
+pub const Partial = struct {
+    ratio: f64, // times the fundamental
+    level: f32,
+    // Seconds to fall by 60 dB; 0 holds the level until `stop`.
+    decay: f32 = 0,
+};
+
+// Below this every partial counts as silent.
+const SILENCE: f32 = 1e-5;
+// ln(0.001): -60 dB.
+const LN_60DB = -6.907755278982137;
+
+// `N` partials over one fundamental.
+pub fn Bank(comptime N: usize) type {
+    return struct {
+        const Self = @This();
+        const W = Streamer.VEC_LEN;
+        const V = Streamer.Vec;
+        const CHUNKS = (N + W - 1) / W;
+        // Padded with silent partials to whole vectors.
+        const LEN = CHUNKS * W;
+
+        // The phasors and the rotation they take per sample.
+        re: [LEN]f32 = [_]f32 {1} ** LEN,
+        im: [LEN]f32 = [_]f32 {0} ** LEN,
+        cos: [LEN]f32 = [_]f32 {1} ** LEN,
+        sin: [LEN]f32 = [_]f32 {0} ** LEN,
+        // Amplitude at the end of the last block; the next block ramps from it.
+        amp: [LEN]f32 = [_]f32 {0} ** LEN,
+        level: [LEN]f32 = [_]f32 {0} ** LEN,
+        // Envelope, and its natural log change per sample.
+        env: [LEN]f32 = [_]f32 {1} ** LEN,
+        log_decay: [LEN]f32 = [_]f32 {0} ** LEN,
+        // 0 for partials above Nyquist.
+        gate: [LEN]f32 = [_]f32 {0} ** LEN,
+
+        partials: [N]Partial,
+        amplitude: f32,
+        frequency: f64,
+        release: f32, // secs to fall by 60 dB after `stop`
+
+        pub fn init(amp: f32, freq: f64, partials: [N]Partial) Self {
+            var self = Self { .partials = partials, .amplitude = amp, .frequency = freq, .release = 0.2 };
+            _ = self.reset();
+            return self;
+        }
+
+        // Retunes every partial without restarting their phases.
+        pub fn set_frequency(self: *Self, freq: f64) void {
+            self.frequency = freq;
+            const nyquist = Config.sample_rate_as(f64) / 2;
+            for (self.partials, 0..) |p, k| {
+                const hz = freq * p.ratio;
+                const w = 2 * std.math.pi * hz / Config.sample_rate_as(f64);
+                self.cos[k] = @floatCast(@cos(w));
+                self.sin[k] = @floatCast(@sin(w));
+                self.gate[k] = if (hz < nyquist) 1 else 0;
+            }
+        }
+
+        // Changes one partial's level, reached by the end of the next block.
+        pub fn set_level(self: *Self, k: usize, level: f32) void {
+            self.partials[k].level = level;
+            self.level[k] = level;
+        }
+
+        fn set_decay(self: *Self, k: usize, secs: f32) void {
+            self.log_decay[k] = if (secs > 0) LN_60DB / (secs * Config.sample_rate_as(f32)) else 0;
+        }
+
+        pub fn read(self: *Self, frames: []f32) struct { u32, Streamer.Status } {
+            std.debug.assert(frames.len <= Config.MAX_BLOCK_SIZE);
+            const n = frames.len;
+            if (n == 0) return .{ 0, .Continue };
+            const nf: V = @splat(@floatFromInt(n));
+            // One partial sum per lane and sample, reduced at the end.
+            var acc: [Config.MAX_BLOCK_SIZE]V = undefined;
+            @memset(acc[0..n], @splat(0));
+            var loudest: f32 = 0;
+
+            for (0..CHUNKS) |chunk| {
+                const o = chunk * W;
+                var re: V = self.re[o..][0..W].*;
+                var im: V = self.im[o..][0..W].*;
+                const c: V = self.cos[o..][0..W].*;
+                const s: V = self.sin[o..][0..W].*;
+                const env = @as(V, self.env[o..][0..W].*) * @exp(@as(V, self.log_decay[o..][0..W].*) * nf);
+                const target = @as(V, self.level[o..][0..W].*) * env * @as(V, self.gate[o..][0..W].*);
+                var amp: V = self.amp[o..][0..W].*;
+                const step = (target - amp) / nf;
+                for (acc[0..n]) |*a| {
+                    amp += step;
+                    a.* += amp * im;
+                    const r = re * c - im * s;
+                    im = re * s + im * c;
+                    re = r;
+                }
+                // One Newton step of 1/sqrt(|z|²) pulls the phasors back onto the unit circle,
+                // undoing the rounding the block's rotations accumulated.
+                const g = (@as(V, @splat(3)) - (re * re + im * im)) * @as(V, @splat(0.5));
+                self.re[o..][0..W].* = re * g;
+                self.im[o..][0..W].* = im * g;
+                self.amp[o..][0..W].* = target;
+                self.env[o..][0..W].* = env;
+                loudest = @max(loudest, @reduce(.Max, @abs(target)));
+            }
+            for (frames, acc[0..n]) |*f, a| f.* = @reduce(.Add, a) * self.amplitude;
+            return .{ @intCast(n), if (loudest < SILENCE) .Stop else .Continue };
+        }
+
+        // Note on: phases, envelopes and decays start over. The first block fades in from silence.
+        pub fn reset(self: *Self) bool {
+            @memset(&self.re, 1);
+            @memset(&self.im, 0);
+            @memset(&self.amp, 0);
+            @memset(&self.env, 1);
+            for (self.partials, 0..) |p, k| {
+                self.level[k] = p.level;
+                self.set_decay(k, p.decay);
+            }
+            self.set_frequency(self.frequency);
+            return true;
+        }
+
+        // Note off: every partial fades out over `release`, or sooner if it was already decaying faster.
+        pub fn stop(self: *Self) bool {
+            for (self.partials, 0..) |p, k| {
+                if (p.decay == 0 or p.decay > self.release) self.set_decay(k, self.release);
+            }
+            return true;
+        }
+
+        pub fn streamer(self: *Self) Streamer {
+            return Streamer.make(Self, self);
+        }
+    };
+}
+
+// The first `N` harmonics at level 1/k^`rolloff`, each decaying `decay` / k^`damping` seconds:
+// rolloff 1 is sawtooth-like, and damping > 0 makes the upper harmonics die first, as on a struck string.
+pub fn harmonics(comptime N: usize, rolloff: f32, decay: f32, damping: f32) [N]Partial {
+    var partials: [N]Partial = undefined;
+    for (&partials, 1..) |*p, k| {
+        const kf: f32 = @floatFromInt(k);
+        p.* = .{
+            .ratio = @floatFromInt(k),
+            .level = 1 / std.math.pow(f32, kf, rolloff),
+            .decay = decay / std.math.pow(f32, kf, damping),
+        };
+    }
+    return partials;
+}
@@ -1,6 +1,7 @@
 const c = @import("c");
 const Streamer = @import("streamer.zig");
 const Config = @import("config.zig");
+const Command = @import("command.zig");
 const std = @import("std");
 const builtin = @import("builtin");
 const zemscripten = @import("zemscripten.zig");
@@ -28,11 +29,96 @@ pub fn wait_for_input() void {
 extern fn emscripten_exit_with_live_runtime(status: c_int) void;
 extern fn emscripten_force_exit(status: c_int) void;
 
+// Fills `out` from `streamer`, splitting it into reads of at most `Config.MAX_BLOCK_SIZE` frames.
+// Returns how many frames are valid, which is less than `out.len` only if the streamer stopped.
+pub fn read_blocks(streamer: Streamer, out: []f32) struct { u32, Streamer.Status } {
+    var off: usize = 0;
+    while (off < out.len) {
+        const block = out[off..][0..@min(out.len - off, Config.MAX_BLOCK_SIZE)];
+        const len, const status = streamer.read(block);
+        if (status == .Stop) {
+            @memset(out[off + len..], 0);
+            return .{ @intCast(off + len), .Stop };
+        }
+        off += block.len;
+    }
+    return .{ @intCast(out.len), .Continue };
+}
+
+const VEC_LEN = Streamer.VEC_LEN;
+const Vec = Streamer.Vec;
+
+// Interleaves planar channel buffers (all the same length) into `out`, as the device expects.
+// Passing the same buffer for every channel upmixes a mono signal.
+pub fn interleave(planes: [Config.CHANNELS][]f32, out: []f32) void {
+    const len = planes[0].len;
+    std.debug.assert(out.len == len * Config.CHANNELS);
+    if (Config.CHANNELS == 1) {
+        @memcpy(out, planes[0]);
+    } else {
+        var i: usize = 0;
+        while (i + VEC_LEN <= len) : (i += VEC_LEN) {
+            var vecs: [Config.CHANNELS]Vec = undefined;
+            inline for (0..Config.CHANNELS) |ch| vecs[ch] = planes[ch][i..][0..VEC_LEN].*;
+            out[i * Config.CHANNELS..][0..VEC_LEN * Config.CHANNELS].* = std.simd.interlace(vecs);
+        }
+        while (i < len) : (i += 1) {
+            inline for (0..Config.CHANNELS) |ch| out[i * Config.CHANNELS + ch] = planes[ch][i];
+        }
+    }
+}
+
+// Drives a graph into an interleaved `Config.CHANNELS` buffer.
+// The graph is pulled in planar blocks of at most `Config.MAX_BLOCK_SIZE` frames; a mono graph is
+// read once and duplicated to every channel during the interleave, so it costs nothing extra.
+// Other threads control the graph only through `commands`, which `process` drains before reading.
+pub const Engine = struct {
+    streamer: Streamer,
+    planes: [Config.CHANNELS][Config.MAX_BLOCK_SIZE]f32 = undefined,
+    commands: Command.Queue = .{},
+
+    pub fn init(streamer: Streamer) Engine {
+        return .{ .streamer = streamer };
+    }
+
+    // Returns how many frames are valid, which is less than requested only if the graph stopped.
+    pub fn process(self: *Engine, out: []f32) struct { u32, Streamer.Status } {
+        while (self.commands.pop()) |command| command.apply();
+        const frames = out.len / Config.CHANNELS;
+        var off: usize = 0;
+        while (off < frames) {
+            const n = @min(frames - off, Config.MAX_BLOCK_SIZE);
+            var planes: [Config.CHANNELS][]f32 = undefined;
+            for (&planes, &self.planes) |*plane, *buf| plane.* = buf[0..n];
+            const dest = out[off * Config.CHANNELS..][0..n * Config.CHANNELS];
+            const len, const status = if (self.streamer.is_planar()) blk: {
+                for (planes) |plane| @memset(plane, 0);
+                const res = self.streamer.read_planar(&planes);
+                interleave(planes, dest);
+                break :blk res;
+            } else blk: {
+                @memset(planes[0], 0);
+                const res = self.streamer.read(planes[0]);
+                var mono: [Config.CHANNELS][]f32 = undefined;
+                @memset(&mono, planes[0]);
+                interleave(mono, dest);
+                break :blk res;
+            };
+            if (status == .Stop) {
+                @memset(out[(off + len) * Config.CHANNELS..], 0);
+                return .{ @intCast(off + len), .Stop };
+            }
+            off += n;
+        }
+        return .{ @intCast(frames), .Continue };
+    }
+};
+
 pub fn read_frames(pDevice: [*c]c.ma_device, pOutput: ?*anyopaque, pInput: ?*const anyopaque, frameCount: u32) callconv(.c) void {
     _ = pInput;
     const ctx: *SimpleAudioCtx = @alignCast(@ptrCast(pDevice[0].pUserData));
     const float_out: [*]f32 = @alignCast(@ptrCast(pOutput));
-    _, const status = ctx.streamer.read(float_out[0..frameCount]);
+    _, const status = ctx.engine.process(float_out[0..frameCount * Config.CHANNELS]);
     if (status == .Stop) {
         if (builtin.target.os.tag == .emscripten)
             ctx.deinit()
@@ -44,11 +130,12 @@ pub fn read_frames(pDevice: [*c]c.ma_device, pOutput: ?*anyopaque, pInput: ?*con
     }
 }
 
-pub fn init_device_config(callback: *const AudioCallBack, ctx: *SimpleAudioCtx) c.ma_device_config {
+// A `sample_rate` of 0 asks for the device's native rate.
+pub fn init_device_config(callback: *const AudioCallBack, ctx: *SimpleAudioCtx, sample_rate: u32) c.ma_device_config {
     var device_config = c.ma_device_config_init(c.ma_device_type_playback);
     device_config.playback.format   = Config.DEVICE_FORMAT;
     device_config.playback.channels = Config.CHANNELS;
-    device_config.sampleRate        = Config.SAMPLE_RATE;
+    device_config.sampleRate        = sample_rate;
     device_config.dataCallback      = callback;
     device_config.pUserData         = ctx;
     return device_config;
@@ -63,20 +150,43 @@ pub const SimpleAudioCtx = struct {
     stop_event: c.ma_event = undefined, 
     device: c.ma_device = undefined,
     device_config: c.ma_device_config = undefined,
-    streamer: Streamer = undefined,
+    engine: Engine = undefined,
+    opened: bool = false,
 
-    pub fn init(ctx: *SimpleAudioCtx, streamer: Streamer) !void {
+    // Opens the playback device and makes its rate `Config.sample_rate`.
+    // With a null `sample_rate` the device runs at its native rate, so miniaudio never has to resample;
+    // rates above `Config.MAX_SAMPLE_RATE` are capped. Call this before building the graph, since nodes
+    // convert their times to samples when they are created. `init` opens at the native rate if this wasn't called.
+    pub fn open(ctx: *SimpleAudioCtx, sample_rate: ?u32) !void {
         if (c.ma_event_init(&ctx.stop_event) != c.MA_SUCCESS) {
             // std.log.err("Failed to init stop event", .{});
             return error.EventError;
 
         }
-        ctx.streamer = streamer;
-        ctx.device_config = init_device_config(read_frames, ctx);
+        ctx.device_config = init_device_config(read_frames, ctx, @min(sample_rate orelse 0, Config.MAX_SAMPLE_RATE));
         if (c.ma_device_init(null, &ctx.device_config, &ctx.device) != c.MA_SUCCESS) {
             // std.log.err("Failed to open playback device.", .{});
             return error.DeviceError;
         }
+        if (ctx.device.sampleRate > Config.MAX_SAMPLE_RATE) {
+            c.ma_device_uninit(&ctx.device);
+            ctx.device_config.sampleRate = Config.MAX_SAMPLE_RATE;
+            if (c.ma_device_init(null, &ctx.device_config, &ctx.device) != c.MA_SUCCESS) {
+                return error.DeviceError;
+            }
+        }
+        Config.sample_rate = ctx.device.sampleRate;
+        ctx.opened = true;
+    }
+
+    pub fn init(ctx: *SimpleAudioCtx, streamer: Streamer) !void {
+        if (!ctx.opened) try ctx.open(null);
+        ctx.engine = Engine.init(streamer);
+    }
+
+    // Safe to call from any thread; see `Command`.
+    pub fn send(self: *SimpleAudioCtx, command: Command.Command) !void {
+        return self.engine.commands.push(command);
     }
 
     pub fn start(self: *SimpleAudioCtx) !void {
@@ -86,6 +196,13 @@ pub const SimpleAudioCtx = struct {
         }
     }
 
+    // Returns once the callback in flight (if any) has finished, after which the graph can be modified directly.
+    pub fn stop(self: *SimpleAudioCtx) !void {
+        if (c.ma_device_stop(&self.device) != c.MA_SUCCESS) {
+            return error.DeviceError;
+        }
+    }
+
     pub fn drain(self: *SimpleAudioCtx) void {
         if (builtin.target.os.tag == .emscripten) {
             zemscripten.setMainLoop(loop, null, true);
@@ -0,0 +1,38 @@
+//! Control messages for the audio thread.
+//! Threads other than the audio thread (UI, input, network) must never touch a graph that is playing.
+//! They push a `Command` onto the engine's queue instead, and the engine applies every pending command
+//! at the start of the next device callback, before any node is read. Pushing never blocks,
+//! and draining never waits for a producer.
+const std = @import("std");
+
+const Streamer = @import("streamer.zig");
+const Mixer = @import("mixer.zig");
+const KeyBoard = @import("keyboard.zig");
+const RingBuffer = @import("ring_buffer.zig");
+
+pub const QUEUE_LEN = 256;
+pub const Queue = RingBuffer.MpscQueue(Command, QUEUE_LEN);
+
+pub const Command = union(enum) {
+    note_on: Note,
+    note_off: Note,
+    play: struct { mixer: *Mixer, voice: Mixer.Voice },
+    reset: Streamer,
+    stop: Streamer,
+    // Writes `value` into a parameter the graph reads every block, e.g. `Waveform.Simple.amplitude`.
+    set_param: struct { param: *f32, value: f32 },
+
+    pub const Note = struct { keyboard: *KeyBoard, key: u32 };
+
+    // Audio thread only.
+    pub fn apply(self: Command) void {
+        switch (self) {
+            .note_on => |note| note.keyboard.note_on(note.key),
+            .note_off => |note| note.keyboard.note_off(note.key),
+            .play => |play| play.mixer.play_voice(play.voice),
+            .reset => |stream| _ = stream.reset(),
+            .stop => |stream| _ = stream.stop(),
+            .set_param => |set| set.param.* = set.value,
+        }
+    }
+};
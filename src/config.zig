@@ -1,8 +1,20 @@
 const c = @import("c");
 const Meta = @import("MetaConfig");
-pub const SAMPLE_RATE = 44100;
-pub const CHANNELS = 1;
+pub const DEFAULT_SAMPLE_RATE = 44100;
+// The highest rate the engine runs at. Buffers that hold a fixed amount of time (e.g. `Delay`'s) are sized for it.
+pub const MAX_SAMPLE_RATE = 96000;
+// The rate the graph runs at. `SimpleAudioCtx.open` sets it to the device's native rate; offline renders set it directly.
+// Nodes turn seconds and Hz into samples against it when they are created, so set it before building a graph.
+pub var sample_rate: u32 = DEFAULT_SAMPLE_RATE;
+
+pub fn sample_rate_as(comptime T: type) T {
+    return @floatFromInt(sample_rate);
+}
+pub const CHANNELS = 2;
 pub const DEVICE_FORMAT = c.ma_format_f32;
+// The most frames a node is ever asked for in one `read`. The engine splits larger device periods,
+// so nodes can keep block-sized scratch buffers on the stack (and in L1).
+pub const MAX_BLOCK_SIZE = 256;
 // pub const GUI = Meta.enable_gui;
 pub const GUI = false;
 pub const WAVEFORM_RECORD_GRANULARITY = 20;
@@ -0,0 +1,80 @@
+//! Compressed audio (WAV, FLAC, MP3) through miniaudio's `ma_decoder`, as a `DiskStream.Source`.
+//! The decoder converts to f32, `Config.CHANNELS` channels and `Config.sample_rate` as it decodes, on the
+//! loader thread, into the stream's ring that was allocated up front. The audio thread only copies PCM.
+//! Sample libraries can so stay compressed on disk, or in memory with `open_memory`, at a fraction of the RAM.
+const std = @import("std");
+const c = @import("c");
+
+const Config = @import("config.zig");
+const DiskStream = @import("disk_stream.zig");
+
+const Decoder = @This();
+
+// miniaudio keeps pointers into it, so it lives on the heap and never moves.
+decoder: c.ma_decoder,
+// What it was created with, so a `Stream` that owns it can `close` it.
+allocator: std.mem.Allocator,
+
+// Open after `Config.sample_rate` is final: the output rate is fixed here.
+pub fn open_file(a: std.mem.Allocator, path: [:0]const u8) !*Decoder {
+    const self = try a.create(Decoder);
+    errdefer a.destroy(self);
+    self.allocator = a;
+    const config = output_config();
+    if (c.ma_decoder_init_file(path.ptr, &config, &self.decoder) != c.MA_SUCCESS) return error.DecoderError;
+    return self;
+}
+
+// Decodes from an encoded file already in memory; `data` must outlive the decoder.
+pub fn open_memory(a: std.mem.Allocator, data: []const u8) !*Decoder {
+    const self = try a.create(Decoder);
+    errdefer a.destroy(self);
+    self.allocator = a;
+    const config = output_config();
+    if (c.ma_decoder_init_memory(data.ptr, data.len, &config, &self.decoder) != c.MA_SUCCESS) return error.DecoderError;
+    return self;
+}
+
+fn output_config() c.ma_decoder_config {
+    return c.ma_decoder_config_init(c.ma_format_f32, Config.CHANNELS, Config.sample_rate);
+}
+
+// Only for a decoder that no `Stream` owns; a stream closes its own in `deinit`.
+pub fn close(self: *Decoder) void {
+    _ = c.ma_decoder_uninit(&self.decoder);
+    self.allocator.destroy(self);
+}
+
+fn read(ptr: *anyopaque, out: []f32) anyerror!usize {
+    const self: *Decoder = @ptrCast(@alignCast(ptr));
+    var got: c.ma_uint64 = 0;
+    const result = c.ma_decoder_read_pcm_frames(&self.decoder, out.ptr, out.len / Config.CHANNELS, &got);
+    if (result != c.MA_SUCCESS and result != c.MA_AT_END) return error.DecoderError;
+    return @intCast(got);
+}
+
+fn seek(ptr: *anyopaque, frame: u64) anyerror!void {
+    const self: *Decoder = @ptrCast(@alignCast(ptr));
+    if (c.ma_decoder_seek_to_pcm_frame(&self.decoder, frame) != c.MA_SUCCESS) return error.DecoderError;
+}
+
+fn release(ptr: *anyopaque) void {
+    const self: *Decoder = @ptrCast(@alignCast(ptr));
+    self.close();
+}
+
+// Handing it to a `Stream` hands over the decoder: the stream closes it.
+pub fn source(self: *Decoder) DiskStream.Source {
+    return .{
+        .ptr = @ptrCast(self),
+        .vtable = &.{ .read = read, .seek = seek, .close = release },
+        .channels = Config.CHANNELS,
+    };
+}
+
+// A stream of `path`, decoded by `loader`'s thread. `Stream.deinit` closes the decoder with it.
+pub fn stream(a: std.mem.Allocator, loader: *DiskStream.Loader, path: [:0]const u8, opts: DiskStream.Options) !*DiskStream.Stream {
+    const self = try open_file(a, path);
+    errdefer self.close();
+    return DiskStream.Stream.init(a, loader, self.source(), opts);
+}
@@ -3,9 +3,19 @@ const Streamer = @import("streamer.zig");
 const Config = @import("config.zig");
 const RingBuffer =  @import("ring_buffer.zig");
 
-const MAX_BUF_LEN = Config.SAMPLE_RATE;
+// Half a second at the highest supported rate (about a second at 44.1 kHz).
+// Sized in samples rather than time so the buffers stay inline and small enough to live on the stack.
+// The longest delay is therefore MAX_BUF_LEN / sample_rate secs: 1.088 s at 44.1 kHz, 1 s at 48 kHz
+// and 0.5 s at 96 kHz. `init_secs` clamps longer times to it.
+const MAX_BUF_LEN = Config.MAX_SAMPLE_RATE / 2;
 const DelayBuf = RingBuffer.FixedRingBuffer(f32, MAX_BUF_LEN);
 
+// A delay time in samples that fits a `DelayBuf`.
+fn buf_len_for(secs: f32) u32 {
+    const samples = secs * Config.sample_rate_as(f32);
+    return @intFromFloat(std.math.clamp(samples, 1, MAX_BUF_LEN));
+}
+
 pub const Wait = struct {
     sub_streamer: Streamer,
     samples: u32,
@@ -20,7 +30,7 @@ pub const Wait = struct {
     }
 
     pub fn init_secs(delay_secs: f32, sub_streamer: Streamer) Wait {
-        return init_samples(@intFromFloat(delay_secs * Config.SAMPLE_RATE), sub_streamer);
+        return init_samples(@intFromFloat(delay_secs * Config.sample_rate_as(f32)), sub_streamer);
     }
 
     fn read(ptr: *anyopaque, out: []f32) struct { u32, Streamer.Status } {
@@ -67,7 +77,7 @@ pub const Delay = struct {
     }
 
     pub fn init_secs(delay_secs: f32, playback: f32, sub_streamer: Streamer) Delay {
-        return init_samples(delay_secs / Config.SAMPLE_RATE, playback, sub_streamer);
+        return init_samples(buf_len_for(delay_secs), playback, sub_streamer);
     }
 
     fn read(ptr: *anyopaque, out: []f32) struct { u32, Streamer.Status } {
@@ -85,11 +95,19 @@ pub const Delay = struct {
         return .{ @intCast(out.len), .Continue };
     }
 
+    fn reset(ptr: *anyopaque) bool {
+        const self: *Delay = @alignCast(@ptrCast(ptr));
+        self.buf.clear(0);
+        self.rest = 0;
+        return self.sub_streamer.reset();
+    }
+
     pub fn streamer(self: *Delay) Streamer {
         return .{
             .ptr = @ptrCast(self),
             .vtable = .{
                 .read = read,
+                .reset = reset,
             }
         };
     }
@@ -122,7 +140,7 @@ pub const Reverb = struct {
     pub fn init_secs(delay_secs: [DelayLines]f32, playback: f32, sub_streamer: Streamer) Reverb {
         var delay_samples: [DelayLines]u32 = undefined;
         for (0..DelayLines) |i| {
-            delay_samples[i] = @intFromFloat(delay_secs[i] * Config.SAMPLE_RATE);
+            delay_samples[i] = buf_len_for(delay_secs[i]);
         }
         return init_samples(delay_samples, playback, sub_streamer);
     }
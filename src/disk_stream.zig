@@ -0,0 +1,468 @@
+//! Streaming playback of audio too long to keep in memory.
+//! A `Loader` owns one I/O thread that reads ahead for every `Stream` registered with it, each into its own
+//! `SpscRing`. The audio thread only ever copies out of those rings, so it never touches the disk.
+//! The first `Options.preload` seconds of every stream are read when it is created and kept in memory,
+//! so a (re)started stream plays at once while the loader seeks and catches up behind it.
+//! If a ring runs dry anyway, the stream plays silence for the missing frames and counts an underrun.
+//! A finished voice's stream is taken off the loader with `Loader.remove`, which frees its slot for the next one.
+const std = @import("std");
+const builtin = @import("builtin");
+const Atomic = std.atomic.Value;
+
+const Streamer = @import("streamer.zig");
+const Config = @import("config.zig");
+const RingBuffer = @import("ring_buffer.zig");
+const Sampler = @import("sampler.zig");
+
+pub const MAX_CHANNELS = 8;
+pub const MAX_STREAMS = 256;
+// Frames the loader reads per stream per turn, so one busy stream can't starve the others.
+const CHUNK_FRAMES = 4096;
+// How long the loader sleeps when every ring is full. The rings hold seconds, so polling is plenty,
+// and the audio thread never has to make a system call to wake it.
+const POLL_NS = 2 * std.time.ns_per_ms;
+
+// Where a stream's audio comes from; runs on the loader thread only.
+pub const Source = struct {
+    ptr: *anyopaque,
+    vtable: *const VTable,
+    channels: u16,
+
+    pub const VTable = struct {
+        // Fills `out` with whole interleaved frames. Returns how many, 0 at the end.
+        read: *const fn (ptr: *anyopaque, out: []f32) anyerror!usize,
+        // The next `read` starts at `frame`.
+        seek: *const fn (ptr: *anyopaque, frame: u64) anyerror!void,
+        // Releases the source. Called by `Stream.deinit`, as a stream owns its source.
+        close: ?*const fn (ptr: *anyopaque) void = null,
+    };
+
+    pub fn read(self: Source, out: []f32) !usize {
+        return self.vtable.read(self.ptr, out);
+    }
+
+    pub fn seek(self: Source, frame: u64) !void {
+        return self.vtable.seek(self.ptr, frame);
+    }
+
+    pub fn close(self: Source) void {
+        if (self.vtable.close) |f| f(self.ptr);
+    }
+};
+
+// A WAV or raw PCM file, read with positioned reads and converted to f32.
+pub const FileSource = struct {
+    const BUF_LEN = 64 * 1024;
+    file: std.fs.File,
+    layout: Sampler.Layout,
+    offset: u64, // of frame 0
+    frames: ?u64, // null: to the end of the file
+    pos: u64 = 0,
+    buf: [BUF_LEN]u8 = undefined,
+
+    pub fn open_wav(path: []const u8) !FileSource {
+        const file = try std.fs.cwd().openFile(path, .{});
+        errdefer file.close();
+        var self = FileSource { .file = file, .layout = undefined, .offset = 0, .frames = null };
+        const n = try file.preadAll(&self.buf, 0);
+        const info = try Sampler.parse_wav_header(self.buf[0..n]);
+        self.layout = info.layout;
+        self.offset = info.offset;
+        self.frames = if (info.len) |len| len / self.frame_bytes() else null;
+        try self.check();
+        return self;
+    }
+
+    pub fn open_raw(path: []const u8, layout: Sampler.Layout) !FileSource {
+        const file = try std.fs.cwd().openFile(path, .{});
+        errdefer file.close();
+        var self = FileSource { .file = file, .layout = layout, .offset = 0, .frames = null };
+        try self.check();
+        return self;
+    }
+
+    fn check(self: *const FileSource) !void {
+        if (self.layout.channels == 0 or self.layout.channels > MAX_CHANNELS) return error.UnsupportedFormat;
+    }
+
+    pub fn close(self: *FileSource) void {
+        self.file.close();
+    }
+
+    fn frame_bytes(self: *const FileSource) usize {
+        return @as(usize, self.layout.encoding.bytes()) * self.layout.channels;
+    }
+
+    fn read(ptr: *anyopaque, out: []f32) anyerror!usize {
+        const self: *FileSource = @ptrCast(@alignCast(ptr));
+        const stride = self.frame_bytes();
+        var want = @min(out.len / self.layout.channels, BUF_LEN / stride);
+        if (self.frames) |frames| want = @intCast(@min(want, frames -| self.pos));
+        const n = try self.file.preadAll(self.buf[0 .. want * stride], self.offset + self.pos * stride);
+        const got = n / stride;
+        Sampler.decode_interleaved(self.layout.encoding, self.buf[0 .. got * stride], out[0 .. got * self.layout.channels]);
+        self.pos += got;
+        return got;
+    }
+
+    fn seek(ptr: *anyopaque, frame: u64) anyerror!void {
+        const self: *FileSource = @ptrCast(@alignCast(ptr));
+        self.pos = frame;
+    }
+
+    fn release(ptr: *anyopaque) void {
+        const self: *FileSource = @ptrCast(@alignCast(ptr));
+        self.close();
+    }
+
+    // Handing it to a `Stream` hands over the file too: the stream closes it.
+    pub fn source(self: *FileSource) Source {
+        return .{
+            .ptr = @ptrCast(self),
+            .vtable = &.{ .read = read, .seek = seek, .close = release },
+            .channels = self.layout.channels,
+        };
+    }
+};
+
+pub const Options = struct {
+    preload: f32 = 0.5, // secs kept in memory from the start
+    buffer: f32 = 2, // secs read ahead past the preload
+    gain: f32 = 1,
+};
+
+pub const Stream = struct {
+    source: Source,
+    channels: u16,
+    gain: f32,
+    // The first frames of the source, interleaved.
+    head: []f32,
+    head_frames: u64,
+    ring: RingBuffer.SpscRing(f32),
+    pos: u64 = 0, // frames played since the last reset
+
+    // A reset bumps `want`; the loader seeks back to the end of the head and acknowledges it by setting `ack`,
+    // after storing where in the ring the new data starts. Until then only the head may be played.
+    want: Atomic(u32) = .init(0),
+    ack: Atomic(u32) = .init(0),
+    ack_pos: usize = 0,
+    synced: bool = true,
+    eof: Atomic(bool) = .init(false),
+    // Blocks that came up short because the loader fell behind.
+    underruns: Atomic(u32) = .init(0),
+    // Failed seeks and reads of the source. The loader retries them on its next pass rather than ending
+    // the stream, so a failing disk or a corrupt frame shows up here and as underruns, not as a silent stop.
+    io_errors: Atomic(u32) = .init(0),
+
+    // Reads the head on the calling thread, then hands the stream to `loader`.
+    // The stream owns `source` once created, and `deinit` closes it; if `init` fails, it is still the caller's.
+    pub fn init(a: std.mem.Allocator, loader: *Loader, source: Source, opts: Options) !*Stream {
+        if (source.channels == 0 or source.channels > MAX_CHANNELS) return error.UnsupportedFormat;
+        const rate = Config.sample_rate_as(f32);
+        const head_len = @as(usize, @intFromFloat(opts.preload * rate)) * source.channels;
+        const ring_len = @as(usize, @intFromFloat(@max(1, opts.buffer * rate))) * source.channels;
+
+        const self = try a.create(Stream);
+        errdefer a.destroy(self);
+        const head = try a.alloc(f32, head_len);
+        errdefer a.free(head);
+        self.* = .{
+            .source = source,
+            .channels = source.channels,
+            .gain = opts.gain,
+            .head = head,
+            .head_frames = 0,
+            .ring = try .init(a, ring_len),
+        };
+        errdefer self.ring.deinit(a);
+
+        try source.seek(0);
+        var filled: usize = 0;
+        while (filled < head.len) {
+            const n = try source.read(head[filled..]);
+            if (n == 0) {
+                self.eof.store(true, .monotonic);
+                break;
+            }
+            filled += n * source.channels;
+        }
+        self.head_frames = filled / source.channels;
+        try loader.add(self);
+        return self;
+    }
+
+    // Only once the loader no longer has it: after `Loader.remove`, or after `Loader.deinit`.
+    pub fn deinit(self: *Stream, a: std.mem.Allocator) void {
+        self.source.close();
+        self.ring.deinit(a);
+        a.free(self.head);
+        a.destroy(self);
+    }
+
+    // Loader thread: tops up the ring. Returns whether there was anything to do.
+    fn service(self: *Stream) bool {
+        const want = self.want.load(.acquire);
+        if (want != self.ack.load(.monotonic)) {
+            self.source.seek(self.head_frames) catch {
+                _ = self.io_errors.fetchAdd(1, .monotonic);
+                return false;
+            };
+            self.eof.store(false, .monotonic);
+            self.ack_pos = self.ring.write_pos.load(.monotonic);
+            self.ack.store(want, .release);
+        }
+        if (self.eof.load(.monotonic)) return false;
+
+        const ch: usize = self.channels;
+        const free = self.ring.writable() / ch;
+        // Wait for room for a whole chunk, unless the ring is smaller than one.
+        if (free < @min(CHUNK_FRAMES, self.ring.data.len / ch)) return false;
+        const region = self.ring.write_regions()[0];
+        const frames = @min(region.len / ch, CHUNK_FRAMES);
+        if (frames == 0) return false;
+        const n = self.source.read(region[0 .. frames * ch]) catch {
+            _ = self.io_errors.fetchAdd(1, .monotonic);
+            return false;
+        };
+        self.ring.commit(n * ch);
+        if (n == 0) self.eof.store(true, .release);
+        return true;
+    }
+
+    // Audio thread: copies the next `frames` frames into `out` (interleaved).
+    // Returns how many there were; fewer only once the source has ended.
+    fn pull(self: *Stream, out: []f32) usize {
+        const ch: usize = self.channels;
+        const frames = out.len / ch;
+        if (!self.synced and self.ack.load(.acquire) == self.want.load(.monotonic)) {
+            self.ring.skip_to(self.ack_pos);
+            self.synced = true;
+        }
+        var done: usize = 0;
+        if (self.pos < self.head_frames) {
+            const n: usize = @intCast(@min(frames, self.head_frames - self.pos));
+            const start: usize = @intCast(self.pos * ch);
+            @memcpy(out[0 .. n * ch], self.head[start..][0 .. n * ch]);
+            done = n;
+        }
+        if (done < frames and self.synced) {
+            done += self.ring.read(out[done * ch .. frames * ch]) / ch;
+        }
+        self.pos += done;
+        if (done < frames) {
+            @memset(out[done * ch ..], 0);
+            const ended = self.synced and self.eof.load(.acquire) and self.ring.readable() == 0;
+            if (ended) return done;
+            _ = self.underruns.fetchAdd(1, .monotonic);
+            return frames;
+        }
+        return frames;
+    }
+
+    pub fn read(self: *Stream, frames: []f32) struct { u32, Streamer.Status } {
+        std.debug.assert(frames.len <= Config.MAX_BLOCK_SIZE);
+        const ch: usize = self.channels;
+        var tmp: [Config.MAX_BLOCK_SIZE * MAX_CHANNELS]f32 = undefined;
+        const n = self.pull(tmp[0 .. frames.len * ch]);
+        const scale = self.gain / @as(f32, @floatFromInt(ch));
+        for (frames[0..n], 0..) |*f, i| {
+            var sum: f32 = 0;
+            for (tmp[i * ch ..][0..ch]) |x| sum += x;
+            f.* = sum * scale;
+        }
+        @memset(frames[n..], 0);
+        return .{ @intCast(n), if (n < frames.len) .Stop else .Continue };
+    }
+
+    // Each output channel takes the stream's channel of the same index; a mono stream feeds them all.
+    pub fn read_planar(self: *Stream, channels: []const []f32) struct { u32, Streamer.Status } {
+        const len = channels[0].len;
+        std.debug.assert(len <= Config.MAX_BLOCK_SIZE);
+        const ch: usize = self.channels;
+        var tmp: [Config.MAX_BLOCK_SIZE * MAX_CHANNELS]f32 = undefined;
+        const n = self.pull(tmp[0 .. len * ch]);
+        for (channels, 0..) |out, k| {
+            const src = @min(k, ch - 1);
+            for (out[0..n], 0..) |*o, i| o.* = tmp[i * ch + src] * self.gain;
+            @memset(out[n..], 0);
+        }
+        return .{ @intCast(n), if (n < len) .Stop else .Continue };
+    }
+
+    // Plays from the start again: the head right away, then the ring once the loader has seeked.
+    pub fn reset(self: *Stream) bool {
+        self.pos = 0;
+        self.synced = false;
+        _ = self.want.fetchAdd(1, .release);
+        return true;
+    }
+
+    pub fn streamer(self: *Stream) Streamer {
+        return Streamer.make(Stream, self);
+    }
+};
+
+pub const Loader = struct {
+    // Written by the control thread only; the loader reads a slot at a time.
+    streams: [MAX_STREAMS]Atomic(?*Stream) = [_]Atomic(?*Stream) {.init(null)} ** MAX_STREAMS,
+    count: Atomic(u32) = .init(0),
+    // Bumped at the end of every pass over `streams`, so `remove` can tell when a stream is out of reach.
+    passes: Atomic(u32) = .init(0),
+    quit: Atomic(bool) = .init(false),
+    thread: std.Thread = undefined,
+
+    pub fn init(a: std.mem.Allocator) !*Loader {
+        const self = try a.create(Loader);
+        errdefer a.destroy(self);
+        self.* = .{};
+        self.thread = try std.Thread.spawn(.{}, run, .{self});
+        return self;
+    }
+
+    // Stops the thread. Streams still added must be deinitialized after this, not before.
+    pub fn deinit(self: *Loader, a: std.mem.Allocator) void {
+        self.quit.store(true, .release);
+        self.thread.join();
+        a.destroy(self);
+    }
+
+    // Called by `Stream.init`, from one control thread at a time.
+    fn add(self: *Loader, stream: *Stream) error{TooManyStreams}!void {
+        const n = self.count.load(.monotonic);
+        if (n == MAX_STREAMS) return error.TooManyStreams;
+        self.streams[n].store(stream, .release);
+        self.count.store(n + 1, .release);
+    }
+
+    // Stops reading ahead for `stream` and frees its slot, so it can be `deinit`ed while the loader runs on.
+    // The audio thread must be done with it too, e.g. it has left the `Mixer`. From the control thread, like `add`;
+    // waits until the loader has finished every pass that could still reach the stream, a few ms at most.
+    pub fn remove(self: *Loader, stream: *Stream) void {
+        const n = self.count.load(.monotonic);
+        const i = for (self.streams[0..n], 0..) |*slot, k| {
+            if (slot.load(.monotonic) == stream) break k;
+        } else unreachable; // not added to this loader
+        // The last stream takes its place. A pass running meanwhile may visit that one twice, which is harmless.
+        self.streams[i].store(self.streams[n - 1].load(.monotonic), .seq_cst);
+        self.count.store(n - 1, .seq_cst);
+        self.streams[n - 1].store(null, .seq_cst);
+
+        // The pass under way may already hold `stream`; the one after it can't. Slots and `passes` are all seq_cst,
+        // on both threads: with release/acquire alone, this load of `passes` and the loader's next load of the
+        // slot could each miss the other side's store.
+        const seen = self.passes.load(.seq_cst);
+        while (self.passes.load(.seq_cst) -% seen < 2) std.Thread.sleep(POLL_NS / 2);
+    }
+
+    fn run(self: *Loader) void {
+        while (!self.quit.load(.acquire)) {
+            var busy = false;
+            for (self.streams[0..self.count.load(.seq_cst)]) |*slot| {
+                const stream = slot.load(.seq_cst) orelse continue;
+                if (stream.service()) busy = true;
+            }
+            _ = self.passes.fetchAdd(1, .seq_cst);
+            if (!busy) std.Thread.sleep(POLL_NS);
+        }
+    }
+};
+
+// Plays frame k as k + 1 (so silence is never mistaken for data), `frames` long.
+const TestSource = struct {
+    frames: u64,
+    pos: u64 = 0,
+    closed: *Atomic(u32),
+
+    fn read(ptr: *anyopaque, out: []f32) anyerror!usize {
+        const self: *TestSource = @ptrCast(@alignCast(ptr));
+        const n: usize = @intCast(@min(out.len, self.frames - self.pos));
+        for (out[0..n], 0..) |*x, i| x.* = @floatFromInt(self.pos + i + 1);
+        self.pos += n;
+        return n;
+    }
+
+    fn seek(ptr: *anyopaque, frame: u64) anyerror!void {
+        const self: *TestSource = @ptrCast(@alignCast(ptr));
+        self.pos = frame;
+    }
+
+    fn release(ptr: *anyopaque) void {
+        const self: *TestSource = @ptrCast(@alignCast(ptr));
+        _ = self.closed.fetchAdd(1, .monotonic);
+    }
+
+    fn source(self: *TestSource) Source {
+        return .{ .ptr = @ptrCast(self), .vtable = &.{ .read = read, .seek = seek, .close = release }, .channels = 1 };
+    }
+};
+
+test "streams are added and removed while the loader runs" {
+    if (builtin.single_threaded) return error.SkipZigTest;
+    const a = std.testing.allocator;
+    const loader = try Loader.init(a);
+    defer loader.deinit(a);
+    var closed = Atomic(u32).init(0);
+    var sources: [8]TestSource = undefined;
+    var live: [8]?*Stream = [_]?*Stream {null} ** 8;
+    var created: u32 = 0;
+    var prng = std.Random.DefaultPrng.init(0);
+    const random = prng.random();
+
+    for (0..200) |_| {
+        const k = random.uintLessThan(usize, live.len);
+        if (live[k]) |stream| {
+            loader.remove(stream);
+            stream.deinit(a);
+            live[k] = null;
+        } else {
+            sources[k] = .{ .frames = 1 << 20, .closed = &closed };
+            live[k] = try Stream.init(a, loader, sources[k].source(), .{ .preload = 0.001, .buffer = 0.05 });
+            created += 1;
+        }
+        std.Thread.sleep(random.uintLessThan(u64, 200) * std.time.ns_per_us);
+    }
+    for (live) |s| {
+        const stream = s orelse continue;
+        loader.remove(stream);
+        stream.deinit(a);
+    }
+    try std.testing.expectEqual(0, loader.count.load(.monotonic));
+    try std.testing.expectEqual(created, closed.load(.monotonic));
+}
+
+test "a reset while the loader writes never plays data from before it" {
+    if (builtin.single_threaded) return error.SkipZigTest;
+    const a = std.testing.allocator;
+    const loader = try Loader.init(a);
+    defer loader.deinit(a);
+    var closed = Atomic(u32).init(0);
+    var src = TestSource { .frames = 1 << 22, .closed = &closed };
+    const stream = try Stream.init(a, loader, src.source(), .{ .preload = 0.002, .buffer = 0.05 });
+    defer {
+        loader.remove(stream);
+        stream.deinit(a);
+    }
+
+    var prng = std.Random.DefaultPrng.init(1);
+    const random = prng.random();
+    var out: [64]f32 = undefined;
+    var expected: f32 = 1;
+    var wrong: usize = 0;
+    var from_ring: usize = 0;
+    for (0..2000) |_| {
+        if (random.uintLessThan(u32, 32) == 0) {
+            _ = stream.reset();
+            expected = 1;
+        }
+        _ = stream.read(&out);
+        for (out) |x| {
+            if (x == 0) continue; // an underrun
+            if (x != expected) wrong += 1;
+            if (x > @as(f32, @floatFromInt(stream.head_frames))) from_ring += 1;
+            expected = x + 1;
+        }
+        std.Thread.sleep(200 * std.time.ns_per_us);
+    }
+    try std.testing.expectEqual(0, wrong);
+    try std.testing.expect(from_ring > 0);
+}
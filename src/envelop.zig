@@ -3,6 +3,9 @@ const Streamer = @import("streamer.zig");
 const Config = @import("config.zig");
 const lerp = std.math.lerp;
 
+// What a cursor or generator does with the values it produces.
+pub const Op = enum { write, mul };
+
 pub const EnvelopStorage = union(enum) {
     static: comptime_int,
     dynamic,
@@ -39,68 +42,113 @@ pub fn LinearEnvelop(comptime DuraT: type, comptime ValT: type, comptime storage
                 return .{ 0, .Stop };
             }
         }
-    };
-}
 
-pub const SimpleCutoff = struct {
-    cutoff_sec: f32,
-    t: f32 = 0,
-    sub_stream: Streamer,
-
-    fn read(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
-        const self: *SimpleCutoff = @alignCast(@ptrCast(ptr));
-        const advance = 1.0/@as(comptime_float, @floatFromInt(Config.SAMPLE_RATE));
-        const len, const sub_status = self.sub_stream.read(frames);
-
-        for (0..frames.len) |i| {
-            self.t += advance;
-            if (self.t >= self.cutoff_sec) {
-                @memset(frames[i..], 0);
-                return .{ @intCast(i), .Stop };
+        // Walks the envelope block by block at `Config.sample_rate`, producing the same values as `get` at
+        // t = 1/rate, 2/rate, ... It remembers the current segment and how many samples are left in it,
+        // so a sample costs one add no matter how many breakpoints there are.
+        pub const Cursor = struct {
+            next: usize = 0, // the segment entered once `remaining` runs out
+            k: u64 = 0, // samples produced so far
+            seg_start: DuraT = 0, // secs, summed like `get` sums them
+            remaining: u64 = 0,
+            base: f64 = 0, // value at the first sample of the current segment
+            step: f64 = 0, // per sample
+            offset: u64 = 0, // samples into the current segment
+
+            // Enters the next non-empty segment if the current one is done. Returns false past the end.
+            fn enter(self: *Cursor, le: *const Self) bool {
+                const rate = Config.sample_rate_as(f64);
+                while (self.remaining == 0) {
+                    const i = self.next;
+                    if (i == le.durations.len) return false;
+                    if (i > 0) self.seg_start += le.durations[i-1];
+                    self.next += 1;
+                    // Sample k plays at k/rate, so the segment holds the samples with k/rate < end_t.
+                    // Compared in `DuraT`, exactly the way `get` compares, so both agree on which side of a breakpoint
+                    // a sample falls, for f32 envelopes too.
+                    const first = self.k + 1;
+                    const end_t = self.seg_start + le.durations[i];
+                    var end: u64 = @intFromFloat(@max(0, @ceil(end_t * Config.sample_rate_as(DuraT))));
+                    while (end > 0 and sample_time(end - 1) >= end_t) end -= 1;
+                    while (sample_time(end) < end_t) end += 1;
+                    self.remaining = end -| first;
+                    if (self.remaining == 0) continue;
+                    const dura: f64 = le.durations[i];
+                    const from: f64 = le.heights[i];
+                    const to: f64 = le.heights[i+1];
+                    const slope = (to - from) / dura;
+                    self.base = from + (@as(f64, @floatFromInt(first)) / rate - @as(f64, self.seg_start)) * slope;
+                    self.step = slope / rate;
+                    self.offset = 0;
+                }
+                return true;
             }
-        } else {
-            return .{ len, sub_status };
-        }
-    }
 
-    pub fn streamer(self: *SimpleCutoff) Streamer {
-        return .{
-            .ptr = @ptrCast(self),
-            .vtable = .{
-                .read = read,
-                .reset = reset,
-            },
+            // When sample k plays, computed the way a caller of `get` would.
+            fn sample_time(k: u64) DuraT {
+                return @as(DuraT, @floatFromInt(k)) / Config.sample_rate_as(DuraT);
+            }
+
+            // Writes the next `out.len` values into `out`, or multiplies `out` by them.
+            // Returns how many were produced, which is short of `out.len` only once the envelope is over.
+            pub fn run(self: *Cursor, le: *const Self, out: []ValT, comptime op: Op) struct { u32, Streamer.Status } {
+                var i: usize = 0;
+                while (i < out.len) {
+                    if (!self.enter(le)) return .{ @intCast(i), .Stop };
+                    const n: usize = @intCast(@min(self.remaining, out.len - i));
+                    const start = self.base + @as(f64, @floatFromInt(self.offset)) * self.step;
+                    ramp(out[i..][0..n], @floatCast(start), @floatCast(self.step), op);
+                    self.offset += n;
+                    self.remaining -= n;
+                    self.k += n;
+                    i += n;
+                }
+                return .{ @intCast(out.len), .Continue };
+            }
         };
-    }
 
-    fn reset(ptr: *anyopaque) bool {
-        const self: *SimpleCutoff = @alignCast(@ptrCast(ptr));
-        self.t = 0;
-        return self.sub_stream.reset();
-    }   
-};
+        fn ramp(out: []ValT, start: ValT, step: ValT, comptime op: Op) void {
+            const N = std.simd.suggestVectorLength(ValT) orelse 4;
+            const V = @Vector(N, ValT);
+            var v = @as(V, @splat(start)) + std.simd.iota(ValT, N) * @as(V, @splat(step));
+            const inc: V = @splat(step * N);
+            var i: usize = 0;
+            while (i + N <= out.len) : (i += N) {
+                switch (op) {
+                    .write => out[i..][0..N].* = v,
+                    .mul => out[i..][0..N].* = @as(V, out[i..][0..N].*) * v,
+                }
+                v += inc;
+            }
+            while (i < out.len) : (i += 1) {
+                const x = start + @as(ValT, @floatFromInt(i)) * step;
+                switch (op) {
+                    .write => out[i] = x,
+                    .mul => out[i] *= x,
+                }
+            }
+        }
+    };
+}
 
-pub fn Envelop(comptime storage: EnvelopStorage) type {
+pub const SimpleCutoff = SimpleCutoffOver(Streamer);
+
+// The nodes below are generic over the type of their sub node. With `Streamer` they take any graph;
+// with a concrete node type the sub node is stored by value and called directly (see `graph.zig`).
+pub fn SimpleCutoffOver(comptime Sub: type) type {
     return struct {
         const Self = @This();
-        pub const LinearEnvelopT = LinearEnvelop(f32, f32, storage);
-        le: LinearEnvelopT,
-        t: f32,
-        sub_stream: Streamer,
-
-        pub fn init(durations: LinearEnvelopT.DurasT, heights: LinearEnvelopT.ValsT, sub_stream: Streamer) Self {
-            return .{ .le = LinearEnvelop(f32, f32, storage).init(durations, heights), .t = 0, .sub_stream = sub_stream };
-        }
+        cutoff_sec: f32,
+        t: f32 = 0,
+        sub_stream: Sub,
 
-        fn read(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
-            const self: *Self = @alignCast(@ptrCast(ptr));
+        pub fn read(self: *Self, frames: []f32) struct { u32, Streamer.Status } {
+            const advance = 1.0/Config.sample_rate_as(f32);
             const len, const sub_status = self.sub_stream.read(frames);
-            const advance = 1.0/@as(comptime_float, @floatFromInt(Config.SAMPLE_RATE));
+
             for (0..frames.len) |i| {
                 self.t += advance;
-                const mul, const status = self.le.get(self.t);
-                frames[i] *= mul;
-                if (status == .Stop) {
+                if (self.t >= self.cutoff_sec) {
                     @memset(frames[i..], 0);
                     return .{ @intCast(i), .Stop };
                 }
@@ -110,112 +158,272 @@ pub fn Envelop(comptime storage: EnvelopStorage) type {
         }
 
         pub fn streamer(self: *Self) Streamer {
-            return .{
-                .ptr = @ptrCast(self),
-                .vtable = .{
-                    .read = read,
-                    .reset = reset,
-                },
-            };
+            return Streamer.make(Self, self);
         }
 
-        fn reset(ptr: *anyopaque) bool {
-            const self: *Self = @alignCast(@ptrCast(ptr));
+        pub fn reset(self: *Self) bool {
             self.t = 0;
             return self.sub_stream.reset();
+        }   
+    };
+}
+
+pub fn Envelop(comptime storage: EnvelopStorage) type {
+    return EnvelopOver(storage, Streamer);
+}
+
+pub fn EnvelopOver(comptime storage: EnvelopStorage, comptime Sub: type) type {
+    return struct {
+        const Self = @This();
+        pub const LinearEnvelopT = LinearEnvelop(f32, f32, storage);
+        le: LinearEnvelopT,
+        cursor: LinearEnvelopT.Cursor = .{},
+        sub_stream: Sub,
+
+        pub fn init(durations: LinearEnvelopT.DurasT, heights: LinearEnvelopT.ValsT, sub_stream: Sub) Self {
+            return .{ .le = LinearEnvelop(f32, f32, storage).init(durations, heights), .sub_stream = sub_stream };
+        }
+
+        pub fn read(self: *Self, frames: []f32) struct { u32, Streamer.Status } {
+            const len, const sub_status = self.sub_stream.read(frames);
+            const n, const status = self.cursor.run(&self.le, frames, .mul);
+            if (status == .Stop) {
+                @memset(frames[n..], 0);
+                return .{ n, .Stop };
+            }
+            return .{ len, sub_status };
+        }
+
+        pub fn streamer(self: *Self) Streamer {
+            return Streamer.make(Self, self);
+        }
+
+        pub fn reset(self: *Self) bool {
+            self.cursor = .{};
+            return self.sub_stream.reset();
         }
 
     };
 }
 
-pub const LiveEnvelop = struct {
-    attack: f64,
-    decay: f64,
-    release: f64,
+// Produces start, start*mul + add, ... into `out` (or multiplies `out` by them), and returns the value that
+// would come next. With `mul` = 1 this is a linear ramp; with `mul` < 1 an exponential approach to add/(1-mul).
+// A whole vector is computed from the value before it, so it costs one multiply-add per sample.
+pub fn recurrence(out: []f32, start: f32, mul: f32, add: f32, comptime op: Op) f32 {
+    const N = Streamer.VEC_LEN;
+    const V = @Vector(N, f32);
+    // v[k] = v[0]*mul^k + add*(1 + mul + ... + mul^(k-1))
+    var pow: [N]f32 = undefined;
+    var sum: [N]f32 = undefined;
+    pow[0] = 1;
+    sum[0] = 0;
+    for (1..N) |k| {
+        pow[k] = pow[k-1] * mul;
+        sum[k] = sum[k-1] * mul + 1;
+    }
+    const pow_v: V = pow;
+    const add_v = @as(V, sum) * @as(V, @splat(add));
+    const mul_n = pow[N-1] * mul;
+    const add_n = (sum[N-1] * mul + 1) * add;
 
-    t: f64 = 0,
-    should_sustain: bool = true,
-    sustain_end_t: f64 = undefined,
+    var v = start;
+    var i: usize = 0;
+    while (i + N <= out.len) : (i += N) {
+        const vals = @as(V, @splat(v)) * pow_v + add_v;
+        switch (op) {
+            .write => out[i..][0..N].* = vals,
+            .mul => out[i..][0..N].* = @as(V, out[i..][0..N].*) * vals,
+        }
+        v = v * mul_n + add_n;
+    }
+    while (i < out.len) : (i += 1) {
+        switch (op) {
+            .write => out[i] = v,
+            .mul => out[i] *= v,
+        }
+        v = v * mul + add;
+    }
+    return v;
+}
 
-    sub_stream: Streamer,
+// An attack-decay-sustain-release generator. Every stage is a `recurrence`, so curved stages cost
+// the same as straight ones.
+pub const Adsr = struct {
+    pub const Params = struct {
+        attack: f32, // secs
+        decay: f32,
+        sustain: f32 = 0.6, // level
+        release: f32,
+        // 0 is a straight line. Positive values bend a stage into an exponential that moves fast at first and
+        // settles into its target, like an RC circuit; negative values start slow and speed up.
+        // Around 3 to 6 sounds natural for decays and releases.
+        attack_curve: f32 = 0,
+        curve: f32 = 0, // for decay and release
+    };
+    pub const Stage = enum { attack, decay, sustain, release, done };
 
-    pub fn init(attack: f32, decay: f32, release: f32, sub_stream: Streamer) LiveEnvelop {
-        return .{
-            .attack = attack,
-            .decay = attack + decay,
-            .release = release,
-            .sub_stream = sub_stream,
-        };
+    params: Params,
+    stage: Stage = .attack,
+    held: bool = true,
+    value: f32 = 0,
+    target: f32 = 0, // where the current stage ends
+    remaining: u32 = 0, // samples left in the current stage
+    mul: f32 = 1,
+    add: f32 = 0,
+
+    pub fn init(params: Params) Adsr {
+        var adsr = Adsr { .params = params };
+        adsr.note_on();
+        return adsr;
+    }
+
+    // Restarts the attack from silence.
+    pub fn note_on(self: *Adsr) void {
+        self.held = true;
+        self.value = 0;
+        self.enter(.attack);
+    }
+
+    // Releases from the sustain level. A note let go during its attack or decay still completes them first.
+    pub fn note_off(self: *Adsr) void {
+        self.held = false;
+        if (self.stage == .sustain) self.enter(.release);
     }
 
-    pub fn get(self: LiveEnvelop, t: f64) struct { f64, Streamer.Status } {
-        var env_mul: f64 = undefined;
-        var status: Streamer.Status = .Continue;
-        if (t < self.attack) {
-            env_mul = lerp(0.0, 1.0, (t-0)/(self.attack-0));
-        } else if (t < self.decay) {
-            env_mul = lerp(1.0, 0.6, (t-self.attack)/(self.decay-self.attack));
-        } else if (self.should_sustain) {
-            env_mul = 0.6;
-        } else if (t - self.sustain_end_t < self.release) {
-            env_mul = lerp(0.6, 0.0, (t-self.sustain_end_t)/(self.release));
+    fn enter(self: *Adsr, stage: Stage) void {
+        self.stage = stage;
+        switch (stage) {
+            .attack => self.segment(1, self.params.attack, self.params.attack_curve),
+            .decay => self.segment(self.params.sustain, self.params.decay, self.params.curve),
+            .release => self.segment(0, self.params.release, self.params.curve),
+            .sustain, .done => {
+                self.value = if (stage == .sustain) self.params.sustain else 0;
+                self.target = self.value;
+                self.remaining = std.math.maxInt(u32);
+                self.mul = 1;
+                self.add = 0;
+            },
+        }
+    }
+
+    // Sets up the recurrence that takes `value` to `to` in `secs`.
+    fn segment(self: *Adsr, to: f32, secs: f32, curve: f32) void {
+        const len: u32 = @intFromFloat(@max(1, @round(secs * Config.sample_rate_as(f32))));
+        const n: f32 = @floatFromInt(len);
+        const from = self.value;
+        self.target = to;
+        self.remaining = len;
+        if (curve == 0) {
+            self.mul = 1;
+            self.add = (to - from) / n;
         } else {
-            env_mul = 0;
-            status = .Stop;
+            // An exponential through `from` and `to` that would level off at `goal`.
+            const r = @exp(-curve / n);
+            const goal = from + (to - from) / (1 - @exp(-curve));
+            self.mul = r;
+            self.add = goal * (1 - r);
         }
-        return .{env_mul, status};
     }
 
-    fn read(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
-        const self: *LiveEnvelop = @alignCast(@ptrCast(ptr));
-        const len, const sub_status = self.sub_stream.read(frames);
-        const advance = 1.0/@as(comptime_float, @floatFromInt(Config.SAMPLE_RATE));
-        for (0..frames.len) |i| {
-            self.t += advance;
-            const mul, const status = self.get(self.t);
-            frames[i] *= @floatCast(mul);
+    // Writes the next `out.len` levels into `out`, or multiplies `out` by them.
+    // Returns how many were produced, which is short of `out.len` only once the release is over.
+    pub fn run(self: *Adsr, out: []f32, comptime op: Op) struct { u32, Streamer.Status } {
+        var i: usize = 0;
+        while (i < out.len) {
+            if (self.stage == .done) return .{ @intCast(i), .Stop };
+            const n = @min(self.remaining, out.len - i);
+            self.value = recurrence(out[i..][0..n], self.value, self.mul, self.add, op);
+            self.remaining -= @intCast(n);
+            i += n;
+            if (self.remaining == 0) {
+                // Land exactly on the target, whatever rounding the recurrence accumulated.
+                self.value = self.target;
+                self.enter(switch (self.stage) {
+                    .attack => .decay,
+                    .decay => if (self.held) .sustain else .release,
+                    .sustain => .sustain,
+                    .release => .done,
+                    .done => unreachable,
+                });
+            }
+        }
+        return .{ @intCast(out.len), .Continue };
+    }
+};
+
+pub const LiveEnvelop = LiveEnvelopOver(Streamer);
+
+// An `Adsr` applied to a sub node: `reset` is the note on and `stop` the note off.
+pub fn LiveEnvelopOver(comptime Sub: type) type {
+    return struct {
+        const Self = @This();
+        adsr: Adsr,
+        sub_stream: Sub,
+
+        pub fn init(attack: f32, decay: f32, release: f32, sub_stream: Sub) Self {
+            return init_params(.{ .attack = attack, .decay = decay, .release = release }, sub_stream);
+        }
+
+        pub fn init_params(params: Adsr.Params, sub_stream: Sub) Self {
+            return .{ .adsr = .init(params), .sub_stream = sub_stream };
+        }
+
+        pub fn read(self: *Self, frames: []f32) struct { u32, Streamer.Status } {
+            const len, const sub_status = self.sub_stream.read(frames);
+            const n, const status = self.adsr.run(frames, .mul);
             if (status == .Stop) {
-                @memset(frames[i..], 0);
-                return .{ @intCast(i), .Stop };
+                @memset(frames[n..], 0);
+                return .{ n, .Stop };
             }
-        } else {
             return .{ len, sub_status };
         }
-    }
 
-    fn reset(ptr: *anyopaque) bool {
-        const self: *LiveEnvelop = @alignCast(@ptrCast(ptr));
-        self.t = 0;
-        self.should_sustain = true;
-        self.sustain_end_t = 0;
-        return self.sub_stream.reset();
-    }
+        pub fn reset(self: *Self) bool {
+            self.adsr.note_on();
+            return self.sub_stream.reset();
+        }
 
-    fn stop(ptr: *anyopaque) bool {
-        const self: *LiveEnvelop = @alignCast(@ptrCast(ptr));
-        self.should_sustain = false;
-        self.sustain_end_t = @max(self.decay, self.t);
-        return true;
-    }
+        pub fn stop(self: *Self) bool {
+            self.adsr.note_off();
+            return true;
+        }
 
-    pub fn streamer(self: *LiveEnvelop) Streamer {
-        return .{
-            .ptr = @ptrCast(self),
-            .vtable = .{
-                .read = read,
-                .reset = reset,
-                .stop = stop,
-            },
-        };
-    }
-};
+        pub fn streamer(self: *Self) Streamer {
+            return Streamer.make(Self, self);
+        }
+    };
+}
 
 const testing = std.testing;
 test "Linear Envelop" {
-    const le = LinearEnvelop(f64, f64).init(&.{0.5}, &.{440, 440});
+    const le = LinearEnvelop(f64, f64, .dynamic).init(&.{0.5}, &.{440, 440});
     for (0..5) |i| {
-        try testing.expectEqualDeep(le.get(@as(f64, @floatFromInt(i)) * 0.1), .{ 440, .Continue });
+        try testing.expectEqualDeep(.{ 440, .Continue }, le.get(@as(f64, @floatFromInt(i)) * 0.1));
     }
 
-    try testing.expectEqualDeep(le.get(0.6), .{ 0, .Stop });
+    try testing.expectEqualDeep(.{ 0, .Stop }, le.get(0.6));
+}
+
+test "Linear Envelop cursor matches get" {
+    // f32 too: there the breakpoints round differently, and the cursor must still split samples like `get`.
+    inline for (.{ f64, f32 }) |T| {
+        const Le = LinearEnvelop(T, T, .dynamic);
+        const le = Le.init(&.{0.01, 0, 0.02, 0.005}, &.{0, 1, 0.5, 0.25, 0});
+        const tolerance: T = if (T == f64) 1e-9 else 1e-5;
+        var cursor = Le.Cursor {};
+        var out: [100]T = undefined;
+        var k: usize = 0;
+        while (true) {
+            // Uneven blocks, so ramps get split across reads.
+            const n, const status = cursor.run(&le, out[0..37], .write);
+            for (out[0..n]) |v| {
+                k += 1;
+                const expected, _ = le.get(@as(T, @floatFromInt(k)) / Config.sample_rate_as(T));
+                try testing.expectApproxEqAbs(expected, v, tolerance);
+            }
+            if (status == .Stop) break;
+        }
+        _, const status = le.get(@as(T, @floatFromInt(k + 1)) / Config.sample_rate_as(T));
+        try testing.expectEqual(.Stop, status);
+    }
 }
@@ -3,13 +3,24 @@ const std = @import("std");
 const Zynth = @import("zynth");
 const Waveform = Zynth.Waveform;
 const Audio = Zynth.Audio;
+const Streamer = Zynth.Streamer;
+
+const create = Audio.create;
+
+pub fn graph(a: std.mem.Allocator) !Streamer {
+    const sine_wave = create(a, Waveform.Simple.init(0.5, 440, .Sine));
+    return sine_wave.streamer();
+}
+
+pub fn main() !void {
+    var arena = std.heap.ArenaAllocator.init(std.heap.c_allocator);
+    defer arena.deinit();
 
-pub fn main() void {
-    var sine_wave = Waveform.Simple.init(0.5, 440, .Sine);
     var ctx = Audio.SimpleAudioCtx {};
-    ctx.init(sine_wave.streamer()) catch unreachable;
+    try ctx.open(null);
+    try ctx.init(try graph(arena.allocator()));
     defer ctx.deinit();
-    ctx.start() catch unreachable;
+    try ctx.start();
     
     Audio.wait_for_input();
 }
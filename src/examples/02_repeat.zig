@@ -4,15 +4,23 @@ const Zynth = @import("zynth");
 const Waveform = Zynth.Waveform;
 const Replay = Zynth.Replay;
 const Audio = Zynth.Audio;
+const Streamer = Zynth.Streamer;
 
-var random = std.Random.Xoroshiro128.init(0);
+const create = Audio.create;
 
+pub fn graph(a: std.mem.Allocator) !Streamer {
+    const string = create(a, Waveform.StringNoise.init(0.5, 440, 1));
+    const repeat = create(a, Replay.RepeatAfterStop.init(null, string.streamer()));
+    return repeat.streamer();
+}
 
 pub fn main() !void {
-    var string = Waveform.StringNoise.init(0.5, 440, random.random(), 1);
-    var repeat = Replay.RepeatAfterStop.init(null, string.streamer());
+    var arena = std.heap.ArenaAllocator.init(std.heap.c_allocator);
+    defer arena.deinit();
+
     var ctx = Audio.SimpleAudioCtx {};
-    try ctx.init(repeat.streamer());
+    try ctx.open(null);
+    try ctx.init(try graph(arena.allocator()));
     defer ctx.deinit();
     try ctx.start();
 
@@ -10,18 +10,11 @@ const Streamer = Zynth.Streamer;
 
 const Preset = @import("preset");
 
+const create = Audio.create;
 
-pub fn main() !void {
-    const c_alloc = std.heap.c_allocator;
-    var arena = std.heap.ArenaAllocator.init(c_alloc);
-    defer arena.deinit();
-    const a = arena.allocator();
+pub fn graph(a: std.mem.Allocator) !Streamer {
+    const mixer = create(a, Mixer {});
 
-    var mixer = Mixer {};
-
-    var ctx = Audio.SimpleAudioCtx {};
-    try ctx.init(mixer.streamer());
-    try ctx.start();
     const bpm = 120.0;
     const whole_note = 60.0/bpm * 4.0;
     {
@@ -49,5 +42,18 @@ pub fn main() !void {
 
         mixer.play(wait.streamer());
     }
+    return mixer.streamer();
+}
+
+pub fn main() !void {
+    const c_alloc = std.heap.c_allocator;
+    var arena = std.heap.ArenaAllocator.init(c_alloc);
+    defer arena.deinit();
+    const a = arena.allocator();
+
+    var ctx = Audio.SimpleAudioCtx {};
+    try ctx.open(null);
+    try ctx.init(try graph(a));
+    try ctx.start();
     Audio.wait_for_input();
 }
@@ -5,20 +5,29 @@ const AndThen = Zynth.Delay.AndThen;
 const Cutoff = Zynth.Envelop.SimpleCutoff;
 const Waveform = Zynth.Waveform;
 const Audio = Zynth.Audio;
+const Streamer = Zynth.Streamer;
 
+const create = Audio.create;
 
-pub fn main() !void {
-    var sine_wave = Waveform.Simple.init(0.5, 440, .Sine);
-    var envelop1 = Cutoff {.cutoff_sec = 1, .sub_stream = sine_wave.streamer() };
-    var triangle_wave = Waveform.Simple.init(0.5, 440, .Triangle);
-    var envelop2 = Cutoff {.cutoff_sec = 1, .sub_stream = triangle_wave.streamer() };
+pub fn graph(a: std.mem.Allocator) !Streamer {
+    const sine_wave = create(a, Waveform.Simple.init(0.5, 440, .Sine));
+    const envelop1 = create(a, Cutoff {.cutoff_sec = 1, .sub_stream = sine_wave.streamer() });
+    const triangle_wave = create(a, Waveform.Simple.init(0.5, 440, .Triangle));
+    const envelop2 = create(a, Cutoff {.cutoff_sec = 1, .sub_stream = triangle_wave.streamer() });
     
-    var and_then = AndThen {.lhs = envelop1.streamer(), .rhs = envelop2.streamer()};
+    const and_then = create(a, AndThen {.lhs = envelop1.streamer(), .rhs = envelop2.streamer()});
+    return and_then.streamer();
+}
+
+pub fn main() !void {
+    var arena = std.heap.ArenaAllocator.init(std.heap.c_allocator);
+    defer arena.deinit();
+
     var ctx = Audio.SimpleAudioCtx {};
-    try ctx.init(and_then.streamer());
+    try ctx.open(null);
+    try ctx.init(try graph(arena.allocator()));
     defer ctx.deinit();
     try ctx.start();
 
     ctx.drain();
 }
-
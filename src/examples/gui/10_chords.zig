@@ -71,12 +71,14 @@ pub fn main() !void {
         .{0, 5, 14},
     };
 
+    var ctx = Audio.SimpleAudioCtx {};
+    try ctx.open(null);
+
     var mixer = Mixer {};
     try play_progression(&progression, &mixer, alloc);
     var loop = Replay.Repeat.init_secs(whole_note * 4, null, mixer.streamer()); // 4 bars
     var reverb = Zynth.Delay.Reverb.init_randomize(0.25, 1, 0.3, loop.streamer());
 
-    var ctx = Audio.SimpleAudioCtx {};
     try ctx.init(reverb.streamer());
     ctx.device.onData = data_callback;
     try ctx.start();
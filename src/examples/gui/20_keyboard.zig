@@ -33,14 +33,11 @@ var envelops: [total_keys]Envelop.LiveEnvelop = undefined;
 var kb: KeyBoard = undefined;
 const shape_ct = @typeInfo(Waveform.Shape).@"enum".fields.len;
 
-var rand = std.Random.Xoroshiro128.init(0);
-var random = rand.random();
-
 fn init_keyboard_streams(shape: u32, octave: i32, a: std.mem.Allocator) void {
     if (shape == shape_ct) {
         for (0..total_keys) |k| {
             const freq = @exp2(@as(f32, @floatFromInt(k)) / 12.0 + @as(f32, @floatFromInt(octave))) * 440;
-            strings[k] = String.init(0.5, freq, random, null);
+            strings[k] = String.init(0.5, freq, null);
             streams[k] = strings[k].streamer();
         }
     } else {
@@ -70,31 +67,37 @@ pub fn main() !void {
     c.SetTargetFPS(60);
     const rect_w: f32 = WINDOW_W/@as(f32, @floatFromInt(Config.WAVEFORM_RECORD_RINGBUF_SIZE));
 
+    var ctx = Audio.SimpleAudioCtx {};
+    try ctx.open(null);
+
     init_keyboard_streams(0, octave, a);
     const streamer = kb.streamer();
 
-    var ctx = Audio.SimpleAudioCtx {};
     try ctx.init(streamer);
     ctx.device.onData = data_callback;
     try ctx.start();
     defer ctx.deinit();
 
     while (!c.WindowShouldClose()) {
-        kb.listen_input();
+        kb.listen_input(&ctx.engine.commands);
+        // Rebuilding the streams rewrites state the audio thread reads, so pause the device meanwhile.
         if (c.IsKeyPressed(c.KEY_LEFT_ALT)) {
-            _ = streamer.reset();
+            try ctx.stop();
             shape = (shape + 1) % @as(u32, @intCast((shape_ct + 1)));
             init_keyboard_streams(shape, octave, a);
+            try ctx.start();
         }
         if (c.IsKeyPressed(c.KEY_LEFT_SHIFT)) {
+            try ctx.stop();
             octave += 1;
-            _ = streamer.reset();
             init_keyboard_streams(shape, octave, a);
+            try ctx.start();
         }
         if (c.IsKeyPressed(c.KEY_LEFT_CONTROL)) {
+            try ctx.stop();
             octave -= 1;
-            _ = streamer.reset();
             init_keyboard_streams(shape, octave, a);
+            try ctx.start();
         }
         c.BeginDrawing();
         {
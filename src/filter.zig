@@ -0,0 +1,275 @@
+//! Biquad and state-variable filters.
+//! The per-sample math lives in `BiquadState(T)` and `SvfState(T)`, written once for a lane type `T`:
+//! `f32` for a single filter, or `@Vector(N, f32)` to run N voices' filters side by side in one register
+//! (see `BiquadBank` and `SvfBank`). State persists across blocks; only `reset` clears it.
+const std = @import("std");
+
+const Streamer = @import("streamer.zig");
+const Config = @import("config.zig");
+
+pub const Kind = enum {
+    LowPass,
+    HighPass,
+    BandPass, // 0 dB at the centre
+    Notch,
+    LowShelf,
+    HighShelf,
+};
+
+pub const Params = struct {
+    kind: Kind,
+    freq: f64, // Hz: cutoff, centre or shelf midpoint
+    q: f64 = std.math.sqrt1_2,
+    gain_db: f64 = 0, // shelves only
+};
+
+fn splat(comptime T: type, x: f32) T {
+    return if (T == f32) x else @splat(x);
+}
+
+// Sets one lane of `dst` (the whole of it when `T` is f32).
+fn put(comptime T: type, dst: *T, lane: usize, x: f32) void {
+    if (T == f32) {
+        dst.* = x;
+    } else {
+        var lanes: [@typeInfo(T).vector.len]f32 = dst.*;
+        lanes[lane] = x;
+        dst.* = lanes;
+    }
+}
+
+// w0 = 2π f / sample_rate, kept just below Nyquist so the tan/cos below stay finite.
+fn omega(freq: f64) f64 {
+    const nyquist = Config.sample_rate_as(f64) / 2;
+    return std.math.pi * std.math.clamp(freq, 1, nyquist * 0.99) / nyquist;
+}
+
+// Transposed direct form II, with coefficients from the RBJ Audio EQ Cookbook.
+// Cheap, but its state isn't scaled like the signal, so sweep the cutoff with `SvfState` instead.
+pub fn BiquadState(comptime T: type) type {
+    return struct {
+        const Self = @This();
+        b0: T = splat(T, 1),
+        b1: T = splat(T, 0),
+        b2: T = splat(T, 0),
+        a1: T = splat(T, 0),
+        a2: T = splat(T, 0),
+        z1: T = splat(T, 0),
+        z2: T = splat(T, 0),
+
+        pub fn load(self: *Self, lane: usize, p: Params) void {
+            const w = omega(p.freq);
+            const cos = @cos(w);
+            const alpha = @sin(w) / (2 * p.q);
+            const A = std.math.pow(f64, 10, p.gain_db / 40);
+            const sq = 2 * @sqrt(A) * alpha;
+            const b0: f64, const b1: f64, const b2: f64, const a0: f64, const a1: f64, const a2: f64 = switch (p.kind) {
+                .LowPass => .{ (1 - cos) / 2, 1 - cos, (1 - cos) / 2, 1 + alpha, -2 * cos, 1 - alpha },
+                .HighPass => .{ (1 + cos) / 2, -(1 + cos), (1 + cos) / 2, 1 + alpha, -2 * cos, 1 - alpha },
+                .BandPass => .{ alpha, 0, -alpha, 1 + alpha, -2 * cos, 1 - alpha },
+                .Notch => .{ 1, -2 * cos, 1, 1 + alpha, -2 * cos, 1 - alpha },
+                .LowShelf => .{
+                    A * ((A + 1) - (A - 1) * cos + sq),
+                    2 * A * ((A - 1) - (A + 1) * cos),
+                    A * ((A + 1) - (A - 1) * cos - sq),
+                    (A + 1) + (A - 1) * cos + sq,
+                    -2 * ((A - 1) + (A + 1) * cos),
+                    (A + 1) + (A - 1) * cos - sq,
+                },
+                .HighShelf => .{
+                    A * ((A + 1) + (A - 1) * cos + sq),
+                    -2 * A * ((A - 1) + (A + 1) * cos),
+                    A * ((A + 1) + (A - 1) * cos - sq),
+                    (A + 1) - (A - 1) * cos + sq,
+                    2 * ((A - 1) - (A + 1) * cos),
+                    (A + 1) - (A - 1) * cos - sq,
+                },
+            };
+            put(T, &self.b0, lane, @floatCast(b0 / a0));
+            put(T, &self.b1, lane, @floatCast(b1 / a0));
+            put(T, &self.b2, lane, @floatCast(b2 / a0));
+            put(T, &self.a1, lane, @floatCast(a1 / a0));
+            put(T, &self.a2, lane, @floatCast(a2 / a0));
+        }
+
+        pub inline fn tick(self: *Self, x: T) T {
+            const y = self.b0 * x + self.z1;
+            self.z1 = self.b1 * x - self.a1 * y + self.z2;
+            self.z2 = self.b2 * x - self.a2 * y;
+            return y;
+        }
+
+        pub fn clear(self: *Self) void {
+            self.z1 = splat(T, 0);
+            self.z2 = splat(T, 0);
+        }
+    };
+}
+
+// Trapezoidal state-variable filter (Simper's formulation). Its two integrators hold the signal itself,
+// so the cutoff and Q can change every block without clicks or blow-ups.
+pub fn SvfState(comptime T: type) type {
+    return struct {
+        const Self = @This();
+        a1: T = splat(T, 1),
+        a2: T = splat(T, 0),
+        a3: T = splat(T, 0),
+        // The output mixes the input, band-pass and low-pass signals.
+        m0: T = splat(T, 1),
+        m1: T = splat(T, 0),
+        m2: T = splat(T, 0),
+        ic1: T = splat(T, 0),
+        ic2: T = splat(T, 0),
+
+        pub fn load(self: *Self, lane: usize, p: Params) void {
+            const k = 1 / p.q;
+            const A = std.math.pow(f64, 10, p.gain_db / 40);
+            var g = @tan(omega(p.freq) / 2);
+            const m0: f64, const m1: f64, const m2: f64 = switch (p.kind) {
+                .LowPass => .{ 0, 0, 1 },
+                .HighPass => .{ 1, -k, -1 },
+                .BandPass => .{ 0, k, 0 },
+                .Notch => .{ 1, -k, 0 },
+                .LowShelf => blk: {
+                    g /= @sqrt(A);
+                    break :blk .{ 1, k * (A - 1), A * A - 1 };
+                },
+                .HighShelf => blk: {
+                    g *= @sqrt(A);
+                    break :blk .{ A * A, k * (1 - A) * A, 1 - A * A };
+                },
+            };
+            const a1 = 1 / (1 + g * (g + k));
+            put(T, &self.a1, lane, @floatCast(a1));
+            put(T, &self.a2, lane, @floatCast(g * a1));
+            put(T, &self.a3, lane, @floatCast(g * g * a1));
+            put(T, &self.m0, lane, @floatCast(m0));
+            put(T, &self.m1, lane, @floatCast(m1));
+            put(T, &self.m2, lane, @floatCast(m2));
+        }
+
+        pub inline fn tick(self: *Self, x: T) T {
+            const v3 = x - self.ic2;
+            const v1 = self.a1 * self.ic1 + self.a2 * v3;
+            const v2 = self.ic2 + self.a2 * self.ic1 + self.a3 * v3;
+            self.ic1 = splat(T, 2) * v1 - self.ic1;
+            self.ic2 = splat(T, 2) * v2 - self.ic2;
+            return self.m0 * x + self.m1 * v1 + self.m2 * v2;
+        }
+
+        pub fn clear(self: *Self) void {
+            self.ic1 = splat(T, 0);
+            self.ic2 = splat(T, 0);
+        }
+    };
+}
+
+// Filters `sub` with a single `State(f32)`.
+fn FilterOver(comptime State: fn (type) type, comptime Sub: type) type {
+    return struct {
+        const Self = @This();
+        state: State(f32),
+        sub_stream: Sub,
+
+        pub fn init(params: Params, sub_stream: Sub) Self {
+            var self = Self { .state = .{}, .sub_stream = sub_stream };
+            self.state.load(0, params);
+            return self;
+        }
+
+        // Retunes without clearing the state, e.g. from a `set_param` style control once per block.
+        pub fn set(self: *Self, params: Params) void {
+            self.state.load(0, params);
+        }
+
+        pub fn read(self: *Self, frames: []f32) struct { u32, Streamer.Status } {
+            const len, const status = self.sub_stream.read(frames);
+            for (frames) |*x| x.* = self.state.tick(x.*);
+            return .{ len, status };
+        }
+
+        pub fn reset(self: *Self) bool {
+            self.state.clear();
+            return self.sub_stream.reset();
+        }
+
+        pub fn streamer(self: *Self) Streamer {
+            return Streamer.make(Self, self);
+        }
+    };
+}
+
+pub fn BiquadOver(comptime Sub: type) type {
+    return FilterOver(BiquadState, Sub);
+}
+
+pub fn SvfOver(comptime Sub: type) type {
+    return FilterOver(SvfState, Sub);
+}
+
+pub const Biquad = BiquadOver(Streamer);
+pub const Svf = SvfOver(Streamer);
+
+// `N` independent filters, one per voice, stepped together: each sample gathers one frame from every
+// voice's buffer into a vector, so N filters cost about as much as one. 4 (SSE/NEON) or 8 (AVX) lanes
+// fill a register; every lane has its own parameters and state.
+fn BankOf(comptime State: fn (type) type, comptime N: usize) type {
+    return struct {
+        const Self = @This();
+        state: State(@Vector(N, f32)) = .{},
+
+        pub fn init(params: [N]Params) Self {
+            var self = Self {};
+            for (params, 0..) |p, lane| self.state.load(lane, p);
+            return self;
+        }
+
+        pub fn set(self: *Self, lane: usize, params: Params) void {
+            self.state.load(lane, params);
+        }
+
+        // Filters every voice's block in place. All buffers must have the same length.
+        pub fn process(self: *Self, buffers: *const [N][]f32) void {
+            const len = buffers[0].len;
+            for (buffers) |buf| std.debug.assert(buf.len == len);
+            for (0..len) |i| {
+                var x: @Vector(N, f32) = undefined;
+                inline for (0..N) |lane| x[lane] = buffers[lane][i];
+                const y = self.state.tick(x);
+                inline for (0..N) |lane| buffers[lane][i] = y[lane];
+            }
+        }
+
+        pub fn reset(self: *Self) void {
+            self.state.clear();
+        }
+    };
+}
+
+pub fn BiquadBank(comptime N: usize) type {
+    return BankOf(BiquadState, N);
+}
+
+pub fn SvfBank(comptime N: usize) type {
+    return BankOf(SvfState, N);
+}
+
+test "Bank lanes match single filters" {
+    const params = [4]Params {
+        .{ .kind = .LowPass, .freq = 500 },
+        .{ .kind = .HighPass, .freq = 2000, .q = 2 },
+        .{ .kind = .Notch, .freq = 1000 },
+        .{ .kind = .LowShelf, .freq = 300, .gain_db = 6 },
+    };
+    var bank = SvfBank(4).init(params);
+    var bufs: [4][64]f32 = undefined;
+    var expected: [4][64]f32 = undefined;
+    for (&bufs, &expected, params, 0..) |*buf, *exp, p, lane| {
+        for (buf, 0..) |*x, i| x.* = @sin(@as(f32, @floatFromInt(i * (lane + 1))) * 0.3);
+        var single = SvfState(f32) {};
+        single.load(0, p);
+        for (exp, buf) |*e, x| e.* = single.tick(x);
+    }
+    bank.process(&.{ &bufs[0], &bufs[1], &bufs[2], &bufs[3] });
+    for (bufs, expected) |buf, exp| try std.testing.expectEqualSlices(f32, &exp, &buf);
+}
@@ -0,0 +1,179 @@
+//! Phase modulation ("FM") synthesis voice, in the style of the 4-operator Yamaha chips.
+//! Each operator is a sine oscillator with its own frequency ratio, level and `Adsr`. An `Algorithm` says which
+//! operators modulate which, and which are heard. All operators of a voice are computed in one loop over the
+//! block, `Kernel.LEN` samples at a time, with modulator outputs passed in registers, so a whole voice costs
+//! one node's dispatch and no scratch buffers between operators.
+const std = @import("std");
+
+const Streamer = @import("streamer.zig");
+const Config = @import("config.zig");
+const Waveform = @import("waveform.zig");
+const Envelop = @import("envelop.zig");
+const Kernel = Waveform.Kernel;
+const Adsr = Envelop.Adsr;
+
+pub const OPS = 4;
+
+pub const Operator = struct {
+    ratio: f64 = 1, // times the note's frequency
+    detune: f64 = 0, // Hz, added after `ratio`
+    // Output amplitude. Into another operator it is the modulation index, in radians.
+    level: f32 = 1,
+    // Self-modulation index, in radians, from the average of the operator's last two samples.
+    feedback: f32 = 0,
+    env: Adsr.Params = .{ .attack = 0.002, .decay = 0.5, .sustain = 1, .release = 0.2 },
+};
+
+pub const Algorithm = struct {
+    // Bit j of `modulators[i]` is set when operator j modulates operator i.
+    // Only higher operators may modulate lower ones, so computing them from the last to the first
+    // always has the inputs ready.
+    modulators: [OPS]u8,
+    carriers: u8, // bit i: operator i is heard
+
+    fn valid(self: Algorithm) bool {
+        for (self.modulators, 0..) |mods, i| {
+            if (mods & ((@as(u16, 2) << @intCast(i)) - 1) != 0) return false;
+        }
+        return self.carriers != 0;
+    }
+};
+
+// The usual 4-operator algorithms, written with `→` for "modulates".
+pub const algorithms = [_]Algorithm {
+    // 3→2→1→0
+    .{ .modulators = .{ 0b0010, 0b0100, 0b1000, 0 }, .carriers = 0b0001 },
+    // (2 + 3)→1→0
+    .{ .modulators = .{ 0b0010, 0b1100, 0, 0 }, .carriers = 0b0001 },
+    // (1 + 3→2)→0
+    .{ .modulators = .{ 0b0110, 0, 0b1000, 0 }, .carriers = 0b0001 },
+    // (3→1 + 2)→0
+    .{ .modulators = .{ 0b0110, 0b1000, 0, 0 }, .carriers = 0b0001 },
+    // 1→0, 3→2: two stacks
+    .{ .modulators = .{ 0b0010, 0, 0b1000, 0 }, .carriers = 0b0101 },
+    // 3→(0, 1, 2)
+    .{ .modulators = .{ 0b1000, 0b1000, 0b1000, 0 }, .carriers = 0b0111 },
+    // 3→2, with 0 and 1 plain sines
+    .{ .modulators = .{ 0, 0, 0b1000, 0 }, .carriers = 0b0111 },
+    // four plain sines
+    .{ .modulators = .{ 0, 0, 0, 0 }, .carriers = 0b1111 },
+};
+
+pub const Params = struct {
+    algorithm: Algorithm = algorithms[0],
+    ops: [OPS]Operator = [_]Operator { .{} } ** OPS,
+};
+
+pub const Voice = struct {
+    params: Params,
+    amp: f32,
+    frequency: f64,
+    phase: [OPS]u32 = [_]u32 {0} ** OPS,
+    inc: [OPS]u32 = [_]u32 {0} ** OPS,
+    adsr: [OPS]Adsr,
+    // The last two outputs of each operator, for feedback.
+    prev: [OPS][2]f32 = [_][2]f32 { .{ 0, 0 } } ** OPS,
+
+    pub fn init(amp: f32, freq: f64, params: Params) Voice {
+        std.debug.assert(params.algorithm.valid());
+        var voice = Voice { .params = params, .amp = amp, .frequency = freq, .adsr = undefined };
+        for (&voice.adsr, params.ops) |*adsr, op| adsr.* = .init(op.env);
+        voice.set_frequency(freq);
+        return voice;
+    }
+
+    pub fn set_frequency(self: *Voice, freq: f64) void {
+        self.frequency = freq;
+        for (&self.inc, self.params.ops) |*inc, op| inc.* = Waveform.phase_increment(freq * op.ratio + op.detune);
+    }
+
+    pub fn read(self: *Voice, frames: []f32) struct { u32, Streamer.Status } {
+        const N = Kernel.LEN;
+        const V = @Vector(N, f32);
+        const U = @Vector(N, u32);
+        std.debug.assert(frames.len <= Config.MAX_BLOCK_SIZE);
+        const alg = self.params.algorithm;
+
+        // Envelopes first, in bulk. Past the end of a release an operator is silent.
+        var env: [OPS][Config.MAX_BLOCK_SIZE + N]f32 = undefined;
+        var playing = false;
+        for (&env, &self.adsr, 0..) |*e, *adsr, i| {
+            const n, _ = adsr.run(e[0..frames.len], .write);
+            @memset(e[n..], 0);
+            if (alg.carriers & (@as(u8, 1) << @intCast(i)) != 0 and adsr.stage != .done) playing = true;
+        }
+
+        var levels: [OPS]V = undefined;
+        var steps: [OPS]U = undefined;
+        for (&levels, &steps, self.params.ops, self.inc) |*l, *s, op, inc| {
+            l.* = @splat(op.level);
+            s.* = std.simd.iota(u32, N) *% @as(U, @splat(inc));
+        }
+        const to_cycles: V = @splat(1 / (2 * std.math.pi));
+        const amp: V = @splat(self.amp);
+
+        var i: usize = 0;
+        while (i < frames.len) : (i += N) {
+            var out: [OPS]V = undefined;
+            var sum: V = @splat(0);
+            var op: usize = OPS;
+            while (op > 0) {
+                op -= 1;
+                var mod: V = @splat(0);
+                inline for (0..OPS) |j| {
+                    if (alg.modulators[op] & (1 << j) != 0) mod += out[j];
+                }
+                const phases = @as(U, @splat(self.phase[op])) +% steps[op];
+                const f = Waveform.phase_unit(N, phases) + mod * to_cycles;
+                const gain = @as(V, env[op][i..][0..N].*) * levels[op];
+                const feedback = self.params.ops[op].feedback;
+                if (feedback == 0) {
+                    out[op] = Kernel.sin_2pi(N, f - @floor(f)) * gain;
+                } else {
+                    // Each sample depends on the ones before it, so this operator goes one lane at a time,
+                    // and stops at the end of the block so the next block continues from the right samples.
+                    const fs: [N]f32 = f;
+                    const gains: [N]f32 = gain;
+                    var ys = [_]f32 {0} ** N;
+                    var p = self.prev[op];
+                    for (0..@min(N, frames.len - i)) |k| {
+                        var x = fs[k] + feedback * (p[0] + p[1]) * 0.5 / (2 * std.math.pi);
+                        x -= @floor(x);
+                        ys[k] = Kernel.sin_2pi(1, .{x})[0] * gains[k];
+                        p = .{ p[1], ys[k] };
+                    }
+                    out[op] = ys;
+                    self.prev[op] = p;
+                }
+                self.phase[op] +%= self.inc[op] *% N;
+                if (alg.carriers & (@as(u8, 1) << @intCast(op)) != 0) sum += out[op];
+            }
+            const y: [N]f32 = sum * amp;
+            const n = @min(N, frames.len - i);
+            @memcpy(frames[i..][0..n], y[0..n]);
+        }
+        // The last chunk ran past the block; wind the phases back to its end.
+        const over: u32 = @intCast(i - frames.len);
+        for (&self.phase, self.inc) |*phase, inc| phase.* -%= inc *% over;
+
+        return .{ @intCast(frames.len), if (playing) .Continue else .Stop };
+    }
+
+    // Note on: every operator restarts its attack from phase 0.
+    pub fn reset(self: *Voice) bool {
+        for (&self.adsr) |*adsr| adsr.note_on();
+        @memset(&self.phase, 0);
+        @memset(&self.prev, .{ 0, 0 });
+        return true;
+    }
+
+    // Note off.
+    pub fn stop(self: *Voice) bool {
+        for (&self.adsr) |*adsr| adsr.note_off();
+        return true;
+    }
+
+    pub fn streamer(self: *Voice) Streamer {
+        return Streamer.make(Voice, self);
+    }
+};
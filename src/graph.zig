@@ -0,0 +1,73 @@
+//! Static composition.
+//! A `Streamer` is type-erased, so a node holding one calls its child through a function pointer
+//! and the compiler can neither inline nor vectorize across the boundary.
+//! Nodes that are generic over their sub node (`Envelop.EnvelopOver`, `Envelop.LiveEnvelopOver`,
+//! `Envelop.SimpleCutoffOver`, `Modulate.RingModulaterOver`, and `Mix` below) can instead hold
+//! concrete node types by value, so a whole voice becomes a single type whose `read` is one
+//! call tree with no indirect calls:
+//!
+//!     const Voice = Envelop.EnvelopOver(.{ .static = 3 }, Waveform.Simple);
+//!     const Pad = Graph.Mix(struct { Voice, Voice, Voice });
+//!     var pad = Pad.init(.{ ... });
+//!     try ctx.init(pad.streamer()); // the only type erasure, at the engine boundary
+//!
+const std = @import("std");
+
+const Streamer = @import("streamer.zig");
+
+// Sums a fixed set of voices held by value. `Voices` is a tuple type of concrete node types.
+// Unlike `Mixer`, the voice set is known at compile time, so every voice's `read` is a direct call.
+// Reports `.Stop` once every voice has stopped, and skips stopped voices until `reset`.
+pub fn Mix(comptime Voices: type) type {
+    const fields = @typeInfo(Voices).@"struct".fields;
+    return struct {
+        const Self = @This();
+        voices: Voices,
+        stopped: [fields.len]bool = [_]bool {false} ** fields.len,
+
+        pub fn init(voices: Voices) Self {
+            return .{ .voices = voices };
+        }
+
+        pub fn read(self: *Self, frames: []f32) struct { u32, Streamer.Status } {
+            return self.read_add(frames, 1);
+        }
+
+        // Voices with their own `read_add` add into `out` directly; the rest go through one scratch block.
+        pub fn read_add(self: *Self, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+            var max_len: u32 = 0;
+            var status: Streamer.Status = .Stop;
+            inline for (fields, 0..) |field, i| {
+                if (!self.stopped[i]) {
+                    const len, const voice_status = Streamer.read_add_of(field.type, &@field(self.voices, field.name), out, gain);
+                    max_len = @max(max_len, len);
+                    self.stopped[i] = voice_status == .Stop;
+                    status = status.orStatus(voice_status);
+                }
+            }
+            return .{ max_len, status };
+        }
+
+        pub fn reset(self: *Self) bool {
+            var success = true;
+            inline for (fields) |field| {
+                success = @field(self.voices, field.name).reset() and success;
+            }
+            @memset(&self.stopped, false);
+            return success;
+        }
+
+        pub fn stop(self: *Self) bool {
+            var success = true;
+            inline for (fields) |field| {
+                const Voice = @TypeOf(@field(self.voices, field.name));
+                if (@hasDecl(Voice, "stop")) success = @field(self.voices, field.name).stop() and success;
+            }
+            return success;
+        }
+
+        pub fn streamer(self: *Self) Streamer {
+            return Streamer.make(Self, self);
+        }
+    };
+}
@@ -4,6 +4,7 @@ const c = @import("c");
 
 const Waveform = @import("waveform.zig");
 const Streamer = @import("streamer.zig");
+const Command = @import("command.zig");
 const Envelop = Waveform.Envelop;
 const KeyBoard = @This();
 
@@ -44,29 +45,43 @@ pub fn init_default_regular_keys(streamers: []const Streamer, a: std.mem.Allocat
     return init(default_regular_key_sequence[0..streamers.len], streamers, a);
 }
 
-pub fn listen_input(keyboard: *KeyBoard) void {
-    for (keyboard.keys, keyboard.streamers, 0..) |key, stream, i| {
+// Polls the keys on the UI thread and sends the presses and releases to the audio thread through `queue`,
+// which is usually `SimpleAudioCtx.engine.commands`. The keyboard's streams are only ever touched by the audio thread.
+pub fn listen_input(keyboard: *KeyBoard, queue: *Command.Queue) void {
+    for (keyboard.keys, 0..) |key, i| {
+        // A full queue means the audio thread has stalled; dropping the key event is the best we can do.
         if (c.IsKeyPressed(key)) {
-            _ = stream.reset();
-            keyboard.playing.set(i);
+            queue.push(.{ .note_on = .{ .keyboard = keyboard, .key = @intCast(i) } }) catch {};
         }
         if (c.IsKeyReleased(key)) {
-            if (!stream.stop()) {
-                keyboard.playing.unset(i);
-            }
+            queue.push(.{ .note_off = .{ .keyboard = keyboard, .key = @intCast(i) } }) catch {};
         }
     }
 }
 
+// Audio thread only; see `Command`.
+pub fn note_on(self: *KeyBoard, i: u32) void {
+    _ = self.streamers[i].reset();
+    self.playing.set(i);
+}
+
+// Audio thread only. Streams that have a release phase keep playing until they report `.Stop`.
+pub fn note_off(self: *KeyBoard, i: u32) void {
+    if (!self.streamers[i].stop()) {
+        self.playing.unset(i);
+    }
+}
+
 fn read(ptr: *anyopaque, float_out: []f32) struct { u32, Streamer.Status } {
+    return read_add(ptr, float_out, 1);
+}
+
+fn read_add(ptr: *anyopaque, out: []f32, gain: f32) struct { u32, Streamer.Status } {
     const self: *KeyBoard = @alignCast(@ptrCast(ptr));
     var max_len: u32 = 0;
-    for (self.streamers, 0..) |stream, i| {
-        var tmp = [_]f32 {0} ** 1024; // TODO: smaller buf size
-        if (!self.playing.isSet(i)) continue;
-        const len, const status = stream.read(tmp[0..float_out.len]);
-        for (0..len) |frame_i|
-            float_out[frame_i] += tmp[frame_i];
+    var it = self.playing.iterator(.{});
+    while (it.next()) |i| {
+        const len, const status = self.streamers[i].read_add(out, gain);
         max_len = @max(max_len, len);
         if (status == .Stop) {
             self.playing.unset(i);
@@ -91,6 +106,7 @@ pub fn streamer(self: *KeyBoard) Streamer {
         .vtable = .{
             .read = read,
             .reset = reset,
+            .read_add = read_add,
         }
     };
 }
@@ -2,46 +2,218 @@ const std = @import("std");
 
 const Waveform = @import("waveform.zig");
 const Streamer = @import("streamer.zig");
-const RingBuffer = @import("ring_buffer.zig");
+const Config = @import("config.zig");
+const WorkerPool = @import("worker_pool.zig");
 
 const Mixer = @This();
 pub const POOL_LEN = 32;
+// Above this many playing voices, voices are rendered in groups of `GROUP_LEN` consecutive voices, each into
+// its own partial sum, and the partial sums are then added in group order. The grouping depends only on
+// the number of playing voices, so the output is bit-identical whether the groups run on one thread or many.
+pub const GROUP_LEN = 4;
+const GROUP_COUNT = POOL_LEN / GROUP_LEN;
 
-streams: RingBuffer.FixedRingBuffer(Streamer, POOL_LEN) = .{},
-tmp: [4096]f32 = undefined,
+// `voices[0..active]` are playing, oldest first.
+// `voices[active..len]` have finished and are parked, so that `reset` can play them again.
+voices: [POOL_LEN]Voice = undefined,
+active: u32 = 0,
+len: u32 = 0,
+// A looping mixer keeps reporting `.Continue` with nothing playing, for mixers fed live through `play`.
+// Otherwise `read` reports `.Stop` once every voice has finished, so an offline render can end on its own.
+looping: bool = false,
+// Called with every voice the mixer lets go of: finished ones, and playing ones stolen when the pool is full.
+// With a callback set, finished voices are handed back instead of parked, so `reset` won't replay them.
+on_release: ?Release = null,
+// Renders the voice groups in parallel. Voices must then not share mutable state (e.g. a `std.Random`).
+pool: ?*WorkerPool = null,
+groups: [GROUP_COUNT]Group = undefined,
+// Which voices reported `.Stop` during the current block; they are released once the block is mixed.
+stopped: [POOL_LEN]bool = undefined,
+block: Block = undefined,
     
 pub const KeyNote = struct {
     key: u8,
     note: i32,
 };
 
+const Group = struct {
+    partial: [Config.CHANNELS][Config.MAX_BLOCK_SIZE]f32,
+    tmp: [Config.CHANNELS][Config.MAX_BLOCK_SIZE]f32,
+    len: u32,
+};
+
+// What the groups of the current block render into.
+const Block = struct {
+    frames: usize,
+    channels: usize,
+    planar: bool,
+};
+
+pub const Release = struct {
+    ptr: ?*anyopaque = null,
+    func: *const fn (ptr: ?*anyopaque, stream: Streamer) void,
+};
+
+pub const Voice = struct {
+    stream: Streamer,
+    gain: f32 = 1,
+    // -1 is hard left, 1 is hard right. Panning only ever attenuates the opposite channel,
+    // so a centred voice sounds the same as a mono graph upmixed by the engine.
+    pan: f32 = 0,
+
+    fn channel_gain(self: Voice, channel: usize) f32 {
+        return self.gain * switch (channel) {
+            0 => @min(1, 1 - self.pan),
+            1 => @min(1, 1 + self.pan),
+            else => 1,
+        };
+    }
+};
+
+// Not thread-safe: once the mixer is playing, other threads should send a `.play` command instead.
 pub fn play(self: *Mixer, stream: Streamer) void {
-    self.streams.push(stream);
+    self.play_voice(.{ .stream = stream });
 }
 
-fn read(ptr: *anyopaque, float_out: []f32) struct { u32, Streamer.Status } {
-    const self: *Mixer = @alignCast(@ptrCast(ptr));
+pub fn play_voice(self: *Mixer, voice: Voice) void {
+    if (self.active == POOL_LEN) {
+        // Every slot is playing: steal the oldest voice.
+        const stolen = self.voices[0];
+        std.mem.copyForwards(Voice, self.voices[0..POOL_LEN-1], self.voices[1..POOL_LEN]);
+        self.active -= 1;
+        self.len -= 1;
+        if (self.on_release) |release| release.func(release.ptr, stolen.stream);
+    }
+    if (self.len == POOL_LEN) {
+        // Make room by forgetting a parked voice.
+        self.len -= 1;
+    }
+    self.voices[self.len] = self.voices[self.active];
+    self.voices[self.active] = voice;
+    self.active += 1;
+    self.len += 1;
+}
+
+pub fn playing(self: *const Mixer) []const Voice {
+    return self.voices[0..self.active];
+}
+
+// Takes the voice at `i` out of the playing set, keeping the others in order.
+fn finish(self: *Mixer, i: u32) void {
+    const voice = self.voices[i];
+    std.mem.copyForwards(Voice, self.voices[i..self.active-1], self.voices[i+1..self.active]);
+    self.active -= 1;
+    if (self.on_release) |release| {
+        std.mem.copyForwards(Voice, self.voices[self.active..self.len-1], self.voices[self.active+1..self.len]);
+        self.len -= 1;
+        release.func(release.ptr, voice.stream);
+    } else {
+        self.voices[self.active] = voice;
+    }
+}
+
+fn status(self: *const Mixer) Streamer.Status {
+    return if (self.active == 0 and !self.looping) .Stop else .Continue;
+}
+
+// Adds `voices` (which start at index `first`) into `out`, and returns the longest length read.
+// Without `planar`, `out` is a single mono channel and pans are ignored.
+fn render(self: *Mixer, first: usize, voices: []const Voice, out: []const []f32, tmp: *[Config.CHANNELS][Config.MAX_BLOCK_SIZE]f32, gain: f32, planar: bool) u32 {
+    const frames = out[0].len;
     var max_len: u32 = 0;
-    for (0..self.streams.data.len) |i| {
-        std.debug.assert(self.tmp.len >= float_out.len);
-        @memset(&self.tmp, 0.0);
-        if (!self.streams.active.isSet(@intCast(i))) continue;
-        const len, const status = self.streams.data[i].read(self.tmp[0..float_out.len]);
-        for (0..len) |frame_i|
-            float_out[frame_i] += self.tmp[frame_i];
+    for (voices, first..) |voice, i| {
+        var len: u32 = undefined;
+        var voice_status: Streamer.Status = undefined;
+        if (!planar) {
+            len, voice_status = voice.stream.read_add(out[0], voice.gain * gain);
+        } else if (voice.stream.is_planar()) {
+            var planes: [Config.CHANNELS][]f32 = undefined;
+            for (planes[0..out.len], tmp[0..out.len]) |*plane, *buf| {
+                plane.* = buf[0..frames];
+                @memset(plane.*, 0.0);
+            }
+            len, voice_status = voice.stream.read_planar(planes[0..out.len]);
+            for (out, planes[0..out.len], 0..) |channel, plane, ch|
+                Streamer.add_scaled(channel[0..len], plane[0..len], voice.channel_gain(ch) * gain);
+        } else {
+            // A mono voice is rendered once and panned into every output channel.
+            const mono = tmp[0][0..frames];
+            @memset(mono, 0.0);
+            len, voice_status = voice.stream.read(mono);
+            for (out, 0..) |channel, ch|
+                Streamer.add_scaled(channel[0..len], mono[0..len], voice.channel_gain(ch) * gain);
+        }
         max_len = @max(max_len, len);
-        _ = status;
-        // if (status == .Stop) self.streams.remove(@intCast(i));
+        self.stopped[i] = voice_status == .Stop;
+    }
+    return max_len;
+}
+
+fn render_group(ptr: *anyopaque, g: u32) void {
+    const self: *Mixer = @alignCast(@ptrCast(ptr));
+    const group = &self.groups[g];
+    const first = g * GROUP_LEN;
+    const last = @min(first + GROUP_LEN, self.active);
+    var partial: [Config.CHANNELS][]f32 = undefined;
+    for (partial[0..self.block.channels], group.partial[0..self.block.channels]) |*plane, *buf| {
+        plane.* = buf[0..self.block.frames];
+        @memset(plane.*, 0.0);
+    }
+    group.len = self.render(first, self.voices[first..last], partial[0..self.block.channels], &group.tmp, 1, self.block.planar);
+}
+
+fn mix(self: *Mixer, out: []const []f32, gain: f32, planar: bool) struct { u32, Streamer.Status } {
+    std.debug.assert(out.len <= Config.CHANNELS);
+    std.debug.assert(out[0].len <= Config.MAX_BLOCK_SIZE);
+    var max_len: u32 = 0;
+    if (self.active <= GROUP_LEN) {
+        // Few voices: add them straight into `out`.
+        max_len = self.render(0, self.voices[0..self.active], out, &self.groups[0].tmp, gain, planar);
+    } else {
+        const group_count = (self.active + GROUP_LEN - 1) / GROUP_LEN;
+        self.block = .{ .frames = out[0].len, .channels = out.len, .planar = planar };
+        if (self.pool) |pool| {
+            pool.run(group_count, self, render_group);
+        } else {
+            for (0..group_count) |g| render_group(self, @intCast(g));
+        }
+        for (self.groups[0..group_count]) |*group| {
+            for (out, group.partial[0..out.len]) |channel, *partial|
+                Streamer.add_scaled(channel[0..group.len], partial[0..group.len], gain);
+            max_len = @max(max_len, group.len);
+        }
+    }
+    // Back to front, so that releasing a voice doesn't move the ones still to check.
+    var i = self.active;
+    while (i > 0) {
+        i -= 1;
+        if (self.stopped[i]) self.finish(i);
     }
-    return .{ max_len, Streamer.Status.Continue };
+    return .{ max_len, self.status() };
+}
+
+// Mono mix: gains apply, pans don't.
+fn read(ptr: *anyopaque, float_out: []f32) struct { u32, Streamer.Status } {
+    return read_add(ptr, float_out, 1);
+}
+
+fn read_add(ptr: *anyopaque, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+    const self: *Mixer = @alignCast(@ptrCast(ptr));
+    return self.mix(&.{out}, gain, false);
+}
+
+fn read_planar(ptr: *anyopaque, channels: []const []f32) struct { u32, Streamer.Status } {
+    const self: *Mixer = @alignCast(@ptrCast(ptr));
+    return self.mix(channels, 1, true);
 }
 
+// Restarts every voice the mixer still holds, including parked ones.
 fn reset(ptr: *anyopaque) bool {
     const self: *Mixer = @alignCast(@ptrCast(ptr));
     var success = true;
-    for (&self.streams.data, 0..) |*stream, i| {
-        if (!self.streams.active.isSet(@intCast(i))) continue;
-        success = stream.reset() and success;
+    self.active = self.len;
+    for (self.voices[0..self.len]) |voice| {
+        success = voice.stream.reset() and success;
     }
     return success;
 }
@@ -52,6 +224,8 @@ pub fn streamer(self: *Mixer) Streamer {
         .vtable = .{
             .read = read,
             .reset = reset,
+            .read_planar = read_planar,
+            .read_add = read_add,
         }
     };
 }
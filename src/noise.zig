@@ -0,0 +1,271 @@
+//! Noise generators.
+//! Random numbers come from `Rng`, a xoroshiro128+ generator run on `LANES` independent states at once,
+//! so a block of noise is produced a vector at a time instead of one `std.Random` call per sample.
+//! Each voice owns its `Rng`, handed out by `Streams` from a single seed, so a patch renders the same
+//! noise on every run, whatever the block size and however voices are spread over threads.
+const std = @import("std");
+
+const Streamer = @import("streamer.zig");
+const Config = @import("config.zig");
+
+pub const LANES = 4;
+// Every u64 draw yields two floats.
+pub const FLOATS = 2 * LANES;
+const U64s = @Vector(LANES, u64);
+const F32s = @Vector(FLOATS, f32);
+
+const Op = Streamer.Op;
+
+pub const Rng = struct {
+    s0: U64s,
+    s1: U64s,
+    // Floats drawn but not handed out yet, so output doesn't depend on how reads are split.
+    cache: [FLOATS]f32 = undefined,
+    cached: u32 = 0,
+
+    fn rotl(x: U64s, comptime r: u6) U64s {
+        return (x << @splat(r)) | (x >> @splat(64 - @as(u7, r)));
+    }
+
+    // `FLOATS` uniform values in [-1, 1).
+    pub fn next(self: *Rng) F32s {
+        const s0 = self.s0;
+        var s1 = self.s1;
+        const r = s0 +% s1;
+        s1 ^= s0;
+        self.s0 = rotl(s0, 55) ^ s1 ^ (s1 << @splat(14));
+        self.s1 = rotl(s1, 36);
+
+        // The top 24 bits of each half, which f32 holds exactly.
+        const lo: @Vector(LANES, u32) = @truncate(r >> @splat(8));
+        const hi: @Vector(LANES, u32) = @truncate(r >> @splat(40));
+        const bits = std.simd.join(lo & @as(@Vector(LANES, u32), @splat(0xFF_FFFF)), hi);
+        const unit = @as(F32s, @floatFromInt(bits)) * @as(F32s, @splat(1.0 / @as(f32, 1 << 24)));
+        return unit * @as(F32s, @splat(2)) - @as(F32s, @splat(1));
+    }
+
+    // One uniform value in [-1, 1).
+    pub fn float(self: *Rng) f32 {
+        if (self.cached == 0) {
+            self.cache = self.next();
+            self.cached = FLOATS;
+        }
+        self.cached -= 1;
+        return self.cache[FLOATS - 1 - self.cached];
+    }
+
+    // Writes (or adds) `amp` times uniform noise in [-1, 1) into `out`.
+    pub fn fill(self: *Rng, out: []f32, amp: f32, comptime op: Op) void {
+        var i: usize = 0;
+        while (self.cached > 0 and i < out.len) : (i += 1) {
+            const x = self.float() * amp;
+            switch (op) {
+                .write => out[i] = x,
+                .add => out[i] += x,
+            }
+        }
+        const a: F32s = @splat(amp);
+        while (i + FLOATS <= out.len) : (i += FLOATS) {
+            const x = self.next() * a;
+            switch (op) {
+                .write => out[i..][0..FLOATS].* = x,
+                .add => out[i..][0..FLOATS].* = @as(F32s, out[i..][0..FLOATS].*) + x,
+            }
+        }
+        while (i < out.len) : (i += 1) {
+            const x = self.float() * amp;
+            switch (op) {
+                .write => out[i] = x,
+                .add => out[i] += x,
+            }
+        }
+    }
+};
+
+// Hands out independent generators derived from one seed. Every lane of every `Rng` starts 2^64 draws after
+// the one before (xoroshiro's jump), so no two streams ever overlap. Only the order of `next` calls matters,
+// so build voices in a fixed order (e.g. on one thread, before playback) to get the same noise every run.
+pub const Streams = struct {
+    state: std.Random.Xoroshiro128,
+
+    pub fn init(seed: u64) Streams {
+        return .{ .state = .init(seed) };
+    }
+
+    pub fn next(self: *Streams) Rng {
+        var s0: [LANES]u64 = undefined;
+        var s1: [LANES]u64 = undefined;
+        for (&s0, &s1) |*a, *b| {
+            a.* = self.state.s[0];
+            b.* = self.state.s[1];
+            self.state.jump();
+        }
+        return .{ .s0 = s0, .s1 = s1 };
+    }
+};
+
+pub const White = struct {
+    amp: f32,
+    rng: Rng,
+
+    pub fn init(amp: f32, rng: Rng) White {
+        return .{ .amp = amp, .rng = rng };
+    }
+
+    pub fn read(self: *White, frames: []f32) struct { u32, Streamer.Status } {
+        self.rng.fill(frames, self.amp, .write);
+        return .{ @intCast(frames.len), .Continue };
+    }
+
+    pub fn read_add(self: *White, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+        self.rng.fill(out, self.amp * gain, .add);
+        return .{ @intCast(out.len), .Continue };
+    }
+
+    pub fn reset(self: *White) bool {
+        _ = self;
+        return true;
+    }
+
+    pub fn streamer(self: *White) Streamer {
+        return Streamer.make(White, self);
+    }
+};
+
+// -3 dB per octave noise, by the Voss-McCartney algorithm: `ROWS` held random values, row k refreshed
+// every 2^k samples, summed with a fresh white value. The randoms for a block are drawn in bulk;
+// per sample only one row changes, so the sum is kept running.
+pub const Pink = struct {
+    pub const ROWS = 16;
+    amp: f32,
+    rng: Rng,
+    rows: [ROWS]f32 = [_]f32 {0} ** ROWS,
+    sum: f32 = 0,
+    counter: u32 = 0,
+
+    pub fn init(amp: f32, rng: Rng) Pink {
+        return .{ .amp = amp, .rng = rng };
+    }
+
+    fn render(self: *Pink, out: []f32, gain: f32, comptime op: Op) void {
+        const scale = self.amp * gain / (ROWS + 1);
+        var off: usize = 0;
+        while (off < out.len) {
+            const n = @min(out.len - off, Config.MAX_BLOCK_SIZE);
+            var rand: [2 * Config.MAX_BLOCK_SIZE]f32 = undefined;
+            self.rng.fill(rand[0..2 * n], 1, .write);
+            for (out[off..][0..n], 0..) |*x, i| {
+                self.counter +%= 1;
+                const row = @min(@ctz(self.counter), ROWS - 1);
+                self.sum += rand[2 * i] - self.rows[row];
+                self.rows[row] = rand[2 * i];
+                const y = (self.sum + rand[2 * i + 1]) * scale;
+                switch (op) {
+                    .write => x.* = y,
+                    .add => x.* += y,
+                }
+            }
+            off += n;
+        }
+    }
+
+    pub fn read(self: *Pink, frames: []f32) struct { u32, Streamer.Status } {
+        self.render(frames, 1, .write);
+        return .{ @intCast(frames.len), .Continue };
+    }
+
+    pub fn read_add(self: *Pink, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+        self.render(out, gain, .add);
+        return .{ @intCast(out.len), .Continue };
+    }
+
+    pub fn reset(self: *Pink) bool {
+        @memset(&self.rows, 0);
+        self.sum = 0;
+        self.counter = 0;
+        return true;
+    }
+
+    pub fn streamer(self: *Pink) Streamer {
+        return Streamer.make(Pink, self);
+    }
+};
+
+// Velvet noise: one impulse of random sign at a random position in every grid cell of
+// sample_rate / `density` samples, silence elsewhere. It sounds smooth from around 2000 impulses per second,
+// and since almost every sample is zero it is the cheapest noise to convolve with (e.g. in reverbs).
+pub const Velvet = struct {
+    amp: f32,
+    rng: Rng,
+    cell_len: f64, // samples
+    t: u64 = 0, // samples produced
+    cell: u64 = 0,
+    impulse_at: u64 = 0,
+    sign: f32 = 1,
+
+    pub fn init(amp: f32, density: f64, rng: Rng) Velvet {
+        var velvet = Velvet { .amp = amp, .rng = rng, .cell_len = @max(1, Config.sample_rate_as(f64) / density) };
+        velvet.place();
+        return velvet;
+    }
+
+    // Picks the impulse of the current cell.
+    fn place(self: *Velvet) void {
+        const start: u64 = @intFromFloat(@round(@as(f64, @floatFromInt(self.cell)) * self.cell_len));
+        const u = self.rng.float();
+        const pos = (@as(f64, u) * 0.5 + 0.5) * self.cell_len;
+        self.impulse_at = start + @as(u64, @intFromFloat(pos));
+        self.sign = if (self.rng.float() < 0) -1 else 1;
+    }
+
+    fn render(self: *Velvet, out: []f32, gain: f32, comptime op: Op) void {
+        if (op == .write) @memset(out, 0);
+        const end = self.t + out.len;
+        while (self.impulse_at < end) {
+            out[@intCast(self.impulse_at - self.t)] += self.sign * self.amp * gain;
+            self.cell += 1;
+            self.place();
+        }
+        self.t = end;
+    }
+
+    pub fn read(self: *Velvet, frames: []f32) struct { u32, Streamer.Status } {
+        self.render(frames, 1, .write);
+        return .{ @intCast(frames.len), .Continue };
+    }
+
+    pub fn read_add(self: *Velvet, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+        self.render(out, gain, .add);
+        return .{ @intCast(out.len), .Continue };
+    }
+
+    pub fn reset(self: *Velvet) bool {
+        self.t = 0;
+        self.cell = 0;
+        self.place();
+        return true;
+    }
+
+    pub fn streamer(self: *Velvet) Streamer {
+        return Streamer.make(Velvet, self);
+    }
+};
+
+test "Streams are reproducible and independent" {
+    var a = Streams.init(42);
+    var b = Streams.init(42);
+    var first = a.next();
+    var again = b.next();
+    var second = a.next();
+    var x: [37]f32 = undefined;
+    var y: [37]f32 = undefined;
+    var z: [37]f32 = undefined;
+    // Split differently, to check that the cache keeps the output independent of read sizes.
+    first.fill(x[0..5], 1, .write);
+    first.fill(x[5..], 1, .write);
+    again.fill(&y, 1, .write);
+    second.fill(&z, 1, .write);
+    try std.testing.expectEqualSlices(f32, &x, &y);
+    try std.testing.expect(!std.mem.eql(f32, &x, &z));
+    for (x) |v| try std.testing.expect(v >= -1 and v < 1);
+}
@@ -3,7 +3,7 @@ const Zynth = @import("zynth");
 const c = Zynth.c;
 const Waveform = Zynth.Waveform;
 const Envelop = Zynth.Envelop;
-const Mixer = Zynth.Mixer;
+const Graph = Zynth.Graph;
 const RingBuffer = Zynth.RingBuffer;
 const Replay = Zynth.Replay;
 const Modulate = Zynth.Modulate;
@@ -11,92 +11,80 @@ const Audio = Zynth.Audio;
 const Config = Zynth.Config;
 const Streamer = Zynth.Streamer;
 
-var rand = std.Random.Xoroshiro128.init(0);
-var random = rand.random();
+// Every noise layer gets its own generator, so drums rendered on different threads never share RNG state,
+// and a kit built in the same order always sounds the same.
+var streams = Zynth.Noise.Streams.init(0);
 
 // TODO: Configurable parameters
 const create = Audio.create;
 
+// Each drum is a static graph (see `Graph`), so a hit renders without per-layer dispatch.
+const Bass = Graph.Mix(struct {
+    Envelop.EnvelopOver(.{ .static = 2 }, Waveform.BrownNoise),
+    Envelop.EnvelopOver(.{ .static = 3 }, Waveform.FreqEnvelop),
+});
+
 pub fn bass(a: std.mem.Allocator) !Streamer {
-    const mixer = create(a, Mixer {});
-    {
-        const hit = create(a, Waveform.BrownNoise {.white = Waveform.WhiteNoise {.amp = 0.65, .random = random }, .rc = 0.1 });
-        const hit_envelop = create(a, Envelop.Envelop(.{ .static = 2 }).init(
-                .{0.005},
-                .{1.0, 0},
-                hit.streamer()));
-        mixer.play(hit_envelop.streamer());
-    }
-    {
-        // TODO: optimize this with static
-        const sine = create(a, Waveform.FreqEnvelop.init(1.0, .init(
-                    try a.dupe(f64, &.{0.02, 0.12}),
-                    try a.dupe(f64, &.{300, 50, 50})
+    // A ~400 Hz rumble.
+    const hit = Waveform.BrownNoise {.white = .init(0.11, streams.next()), .rc = 0.0004 };
+    // TODO: optimize this with static
+    const sine = Waveform.FreqEnvelop.init(1.0, .init(
+                try a.dupe(f64, &.{0.02, 0.12}),
+                try a.dupe(f64, &.{300, 50, 50})
 
-        ), .Sine));
-        const envelop = create(a, Envelop.Envelop(.{ .static = 3 }).init(
-                .{0.02, 0.12},
-                .{1, 0.4, 0.0},
-                sine.streamer()
-        ));
-        mixer.play(envelop.streamer());
-    }
-    return mixer.streamer();
+    ), .Sine);
+    const drum = create(a, Bass.init(.{
+        .init(.{0.005}, .{1.0, 0}, hit),
+        .init(.{0.02, 0.12}, .{1, 0.4, 0.0}, sine),
+    }));
+    return drum.streamer();
 }
 
+const CloseHiHat = Envelop.EnvelopOver(.{ .static = 2 }, Waveform.WhiteNoise);
+
 // TODO: experiment with ring modulator
 pub fn close_hi_hat(a: std.mem.Allocator) !Streamer {
-    const noise = create(a, Waveform.WhiteNoise {.amp = 0.15, .random = random });
-    const envelop = create(a, Envelop.Envelop(.{ .static = 2 }).init(
+    const noise = Waveform.WhiteNoise.init(0.15, streams.next());
+    const envelop = create(a, CloseHiHat.init(
         .{0.05},
         .{1.0, 0.0},
-        noise.streamer()));
+        noise));
     return envelop.streamer();
 }
 
-pub fn snare(a: std.mem.Allocator) !Streamer {
-    const snare_mixer = create(a, Mixer {});
+const Snare = Graph.Mix(struct {
+    Envelop.EnvelopOver(.{ .static = 2 }, Waveform.WhiteNoise),
+    Envelop.EnvelopOver(.{ .static = 2 }, Waveform.FreqEnvelop),
+    Envelop.EnvelopOver(.{ .static = 3 }, Waveform.WhiteNoise),
+    Envelop.EnvelopOver(.{ .static = 4 }, Modulate.RingModulaterOver(Waveform.FreqEnvelop, Waveform.FreqEnvelop)),
+});
 
-    const hit = create(a, Waveform.WhiteNoise {.amp = 1, .random = random });
-    const hit_envelop = create(a, Envelop.Envelop(.{ .static = 2 }).init(
-        .{0.005}, 
-        .{1.0, 1.0}, 
-        hit.streamer()));
-    snare_mixer.play(hit_envelop.streamer());
+pub fn snare(a: std.mem.Allocator) !Streamer {
+    const hit = Waveform.WhiteNoise.init(1, streams.next());
 
-    const body = create(a, Waveform.FreqEnvelop.init(0.7, .{
+    const body = Waveform.FreqEnvelop.init(0.7, .{
         .durations = try a.dupe(f64, &.{0.01, 0.04}),
         .heights = try a.dupe(f64, &.{250, 200, 190}),
-    }, .Sine));
-    const body_envelop = create(a, Envelop.Envelop(.{ .static = 2 }).init(
-        .{0.05}, 
-        .{1, 0.0}, 
-        body.streamer()));
-    snare_mixer.play(body_envelop.streamer());
+    }, .Sine);
 
-    const vibrate = create(a, Waveform.WhiteNoise {.amp = 0.3, .random = random });
-    const vibrate_envelop = create(a, Envelop.Envelop(.{ .static = 3 }).init(
-        .{0.015, 0.05}, 
-        .{0, 1.0, 0}, 
-        vibrate.streamer()));
-    snare_mixer.play(vibrate_envelop.streamer());
+    const vibrate = Waveform.WhiteNoise.init(0.3, streams.next());
 
-    const metallic_mod = create(a, Waveform.FreqEnvelop.init(0.2, .{
+    const metallic_mod = Waveform.FreqEnvelop.init(0.2, .{
         .durations = try a.dupe(f64, &.{0.04}),
         .heights = try a.dupe(f64, &.{200, 180}),
-    }, .Triangle));
+    }, .Triangle);
 
-    const metallic_car = create(a, Waveform.FreqEnvelop.init(1, .{
+    const metallic_car = Waveform.FreqEnvelop.init(1, .{
         .durations = try a.dupe(f64, &.{0.04}),
         .heights = try a.dupe(f64, &.{1000, 1000}),
-    }, .Sine));
-    const ring_mod = create(a, Modulate.RingModulater {.modulator = metallic_mod.streamer(), .carrier = metallic_car.streamer()});
-    const ring_envelop = create(a, Envelop.Envelop(.{ .static = 4 }).init(
-        .{0.01, 0.007, 0.03}, 
-        .{0, 0, 1, 0.0}, 
-        ring_mod.streamer()));
+    }, .Sine);
 
-    snare_mixer.play(ring_envelop.streamer());
+    const drum = create(a, Snare.init(.{
+        .init(.{0.005}, .{1.0, 1.0}, hit),
+        .init(.{0.05}, .{1, 0.0}, body),
+        .init(.{0.015, 0.05}, .{0, 1.0, 0}, vibrate),
+        .init(.{0.01, 0.007, 0.03}, .{0, 0, 1, 0.0}, .{.modulator = metallic_mod, .carrier = metallic_car}),
+    }));
 
-    return snare_mixer.streamer();
+    return drum.streamer();
 }
@@ -0,0 +1,33 @@
+const std = @import("std");
+const Zynth = @import("zynth");
+const Fm = Zynth.Fm;
+const Audio = Zynth.Audio;
+const Streamer = Zynth.Streamer;
+
+const create = Audio.create;
+
+// Two stacks: a bright tine (3→2) over a mellow body (1→0), both fading like a struck key.
+pub const epiano = Fm.Params {
+    .algorithm = Fm.algorithms[4],
+    .ops = .{
+        .{ .ratio = 1, .level = 0.5, .env = .{ .attack = 0.002, .decay = 1.5, .sustain = 0.2, .release = 0.3, .curve = 4 } },
+        .{ .ratio = 1, .level = 1.2, .env = .{ .attack = 0.002, .decay = 0.8, .sustain = 0.1, .release = 0.3, .curve = 4 } },
+        .{ .ratio = 1, .level = 0.15, .env = .{ .attack = 0.001, .decay = 0.4, .sustain = 0, .release = 0.1, .curve = 5 } },
+        .{ .ratio = 14, .level = 1.5, .env = .{ .attack = 0.001, .decay = 0.15, .sustain = 0, .release = 0.1, .curve = 5 } },
+    },
+};
+
+// A single stack with inharmonic ratios and a long ring.
+pub const bell = Fm.Params {
+    .algorithm = Fm.algorithms[0],
+    .ops = .{
+        .{ .ratio = 1, .level = 0.6, .env = .{ .attack = 0.001, .decay = 4, .sustain = 0, .release = 1, .curve = 5 } },
+        .{ .ratio = 3.5, .level = 2.5, .env = .{ .attack = 0.001, .decay = 3, .sustain = 0, .release = 1, .curve = 4 } },
+        .{ .ratio = 1.41, .level = 1, .env = .{ .attack = 0.001, .decay = 2, .sustain = 0, .release = 1, .curve = 4 } },
+        .{ .ratio = 1, .level = 0.5, .feedback = 1.2, .env = .{ .attack = 0.001, .decay = 1, .sustain = 0, .release = 1, .curve = 3 } },
+    },
+};
+
+pub fn voice(a: std.mem.Allocator, params: Fm.Params, freq: f64) Streamer {
+    return create(a, Fm.Voice.init(0.5, freq, params)).streamer();
+}
@@ -1 +1,2 @@
 pub const Drum = @import("drum.zig");
+pub const Fm = @import("fm.zig");
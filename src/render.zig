@@ -0,0 +1,95 @@
+//! Offline rendering.
+//! Pulls a `Streamer` in a tight loop without touching an audio device, so a patch
+//! can be bounced to a file (or a pipe) as fast as the CPU allows.
+const std = @import("std");
+
+const Streamer = @import("streamer.zig");
+const Config = @import("config.zig");
+const Audio = @import("audio.zig");
+
+pub const Format = enum {
+    raw, // headerless little-endian f32 samples
+    wav, // 32-bit IEEE float WAV
+};
+
+pub const Options = struct {
+    format: Format = .wav,
+    // Stop after this many frames, even if the graph never returns `.Stop`.
+    max_frames: ?u64 = null,
+};
+
+pub const Stats = struct {
+    frames: u64 = 0,
+    elapsed_ns: u64 = 0, // wall-clock time spent inside `Streamer.read`
+
+    pub fn secs(self: Stats) f64 {
+        return @as(f64, @floatFromInt(self.frames)) / Config.sample_rate_as(f64);
+    }
+
+    // Seconds of audio produced per second of wall-clock time.
+    pub fn realtime_factor(self: Stats) f64 {
+        if (self.elapsed_ns == 0) return std.math.inf(f64);
+        return self.secs() / (@as(f64, @floatFromInt(self.elapsed_ns)) / std.time.ns_per_s);
+    }
+};
+
+const WAV_HEADER_LEN = 44;
+// Used in place of the chunk sizes when the length is not known up front (e.g. writing to a pipe).
+const WAV_UNKNOWN_LEN = 0xFFFF_FFFF;
+
+pub fn write_wav_header(w: *std.Io.Writer, frames: ?u64) !void {
+    const bytes_per_frame = @sizeOf(f32) * Config.CHANNELS;
+    const data_len: u32 = if (frames) |n| @intCast(@min(n * bytes_per_frame, WAV_UNKNOWN_LEN - WAV_HEADER_LEN)) else WAV_UNKNOWN_LEN;
+    const riff_len: u32 = if (frames != null) data_len + WAV_HEADER_LEN - 8 else WAV_UNKNOWN_LEN;
+
+    try w.writeAll("RIFF");
+    try w.writeInt(u32, riff_len, .little);
+    try w.writeAll("WAVE");
+    try w.writeAll("fmt ");
+    try w.writeInt(u32, 16, .little);
+    try w.writeInt(u16, 3, .little); // WAVE_FORMAT_IEEE_FLOAT
+    try w.writeInt(u16, Config.CHANNELS, .little);
+    try w.writeInt(u32, Config.sample_rate, .little);
+    try w.writeInt(u32, Config.sample_rate * bytes_per_frame, .little);
+    try w.writeInt(u16, bytes_per_frame, .little);
+    try w.writeInt(u16, 32, .little);
+    try w.writeAll("data");
+    try w.writeInt(u32, data_len, .little);
+}
+
+// Rewrites the header of a WAV file produced by `render` once the real length is known.
+pub fn patch_wav_header(file: std.fs.File, frames: u64) !void {
+    var buf: [WAV_HEADER_LEN]u8 = undefined;
+    var w = std.Io.Writer.fixed(&buf);
+    try write_wav_header(&w, frames);
+    try file.pwriteAll(&buf, 0);
+}
+
+// Renders `streamer` block by block into `out` as interleaved `Config.CHANNELS` audio, using `block`
+// as the scratch buffer, so the block size is `block.len / Config.CHANNELS` frames. The graph is driven
+// by the same `Audio.Engine` as the device callback, so larger blocks are split the same way.
+// Returns when the graph reports `.Stop` or `opts.max_frames` have been written.
+pub fn render(streamer: Streamer, block: []f32, out: *std.Io.Writer, opts: Options) !Stats {
+    const block_frames = block.len / Config.CHANNELS;
+    std.debug.assert(block_frames > 0);
+    var engine = Audio.Engine.init(streamer);
+    var stats = Stats {};
+    if (opts.format == .wav) try write_wav_header(out, opts.max_frames);
+
+    var timer = try std.time.Timer.start();
+    while (true) {
+        const want: usize = if (opts.max_frames) |max| @intCast(@min(block_frames, max - stats.frames)) else block_frames;
+        if (want == 0) break;
+
+        const samples = block[0..want * Config.CHANNELS];
+        timer.reset();
+        const written, const status = engine.process(samples);
+        stats.elapsed_ns += timer.read();
+
+        try out.writeAll(std.mem.sliceAsBytes(samples[0..written * Config.CHANNELS]));
+        stats.frames += written;
+        if (status == .Stop) break;
+    }
+    try out.flush();
+    return stats;
+}
@@ -17,7 +17,7 @@ pub const Repeat = struct {
     } 
 
     pub fn init_secs(interval_secs: f32, count: ?u32, sub_streamer: Streamer) Repeat {
-        return init_samples(@intFromFloat(interval_secs*Config.SAMPLE_RATE), count, sub_streamer);
+        return init_samples(@intFromFloat(interval_secs*Config.sample_rate_as(f32)), count, sub_streamer);
     }
 
     fn read(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
@@ -0,0 +1,275 @@
+//! Variable-rate resampling, to play recorded samples at any pitch.
+//! Every output sample is a windowed-sinc (Kaiser) dot product over `taps` input samples. The kernel is
+//! precomputed at `phases` fractional offsets and linearly interpolated between the two nearest ones,
+//! so the ratio can change continuously (pitch bends) without a `@sin` or a table rebuild.
+//! Playing faster than 1:1 moves the source's Nyquist into the audible range, so there is one kernel set
+//! per quarter octave of ratio up to `MAX_RATIO`, each cut off lower, and the loudest aliasing stays filtered out.
+const std = @import("std");
+
+const Streamer = @import("streamer.zig");
+const Config = @import("config.zig");
+
+pub const Quality = enum {
+    Low, // 8 taps: cheap voices where highs are masked anyway
+    Medium, // 16 taps
+    High, // 32 taps: solo instruments and exposed samples
+
+    pub fn taps(self: Quality) usize {
+        return switch (self) {
+            .Low => 8,
+            .Medium => 16,
+            .High => 32,
+        };
+    }
+
+    fn phases(self: Quality) usize {
+        return switch (self) {
+            .Low => 32,
+            .Medium => 64,
+            .High => 128,
+        };
+    }
+
+    // Kaiser β: the stopband attenuation the window can reach with that many taps.
+    fn beta(self: Quality) f64 {
+        return switch (self) {
+            .Low => 5,
+            .Medium => 7,
+            .High => 9,
+        };
+    }
+
+    // Cutoff as a fraction of the Nyquist frequency: wider kernels afford a steeper transition.
+    fn passband(self: Quality) f64 {
+        return switch (self) {
+            .Low => 0.8,
+            .Medium => 0.88,
+            .High => 0.93,
+        };
+    }
+};
+
+pub const MAX_TAPS = Quality.High.taps();
+const BANDS_PER_OCTAVE = 4;
+// Two octaves up. Faster ratios still play, with the top band's cutoff, so some aliasing.
+pub const MAX_RATIO = 4;
+const BANDS = 2 * BANDS_PER_OCTAVE + 1;
+
+const Op = Streamer.Op;
+
+// The kernel sets of one quality, built on first use: `BANDS` × (`phases` + 1) × `taps`. The extra phase
+// is the first one shifted by a whole sample, so interpolating past the last phase never wraps.
+fn Kernels(comptime quality: Quality) type {
+    return struct {
+        const TAPS = quality.taps();
+        const PHASES = quality.phases();
+        const PHASES_F: f64 = @floatFromInt(PHASES);
+        var table: [BANDS][PHASES + 1][TAPS]f32 = undefined;
+        var once = std.once(build);
+
+        fn build() void {
+            const half: f64 = @floatFromInt(TAPS / 2);
+            for (&table, 0..) |*band, b| {
+                const octaves = @as(f64, @floatFromInt(b)) / BANDS_PER_OCTAVE;
+                const cutoff = 0.5 * quality.passband() / std.math.pow(f64, 2, octaves);
+                for (band, 0..) |*phase, p| {
+                    const frac = @as(f64, @floatFromInt(p)) / PHASES_F;
+                    var h: [TAPS]f64 = undefined;
+                    var sum: f64 = 0;
+                    for (&h, 0..) |*x, t| {
+                        // Distance from the output position to input sample t.
+                        const d = @as(f64, @floatFromInt(t)) - (half - 1) - frac;
+                        x.* = sinc(2 * cutoff * d) * kaiser(d / half, quality.beta());
+                        sum += x.*;
+                    }
+                    // Unity gain at DC for every phase, or the interpolation ripples at the phase rate.
+                    for (phase, h) |*o, x| o.* = @floatCast(x / sum);
+                }
+            }
+        }
+
+        fn get() *const [BANDS][PHASES + 1][TAPS]f32 {
+            once.call();
+            return &table;
+        }
+    };
+}
+
+fn sinc(x: f64) f64 {
+    if (x == 0) return 1;
+    return @sin(std.math.pi * x) / (std.math.pi * x);
+}
+
+// Kaiser window at x in [-1, 1].
+fn kaiser(x: f64, b: f64) f64 {
+    return bessel_i0(b * @sqrt(@max(0, 1 - x * x))) / bessel_i0(b);
+}
+
+// Modified Bessel function of the first kind, order 0, by its power series.
+fn bessel_i0(x: f64) f64 {
+    var sum: f64 = 1;
+    var term: f64 = 1;
+    var k: f64 = 1;
+    while (term > 1e-12 * sum) : (k += 1) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// The band whose cutoff sits just below the output's Nyquist frequency at `ratio`.
+fn band_for(ratio: f64) usize {
+    if (ratio <= 1) return 0;
+    const b = @ceil(std.math.log2(ratio) * BANDS_PER_OCTAVE);
+    return @intFromFloat(@min(b, BANDS - 1));
+}
+
+// The ratio that plays a sample recorded at `root` Hz and `source_rate` at `freq` Hz.
+pub fn ratio_for(freq: f64, root: f64, source_rate: u32) f64 {
+    return freq / root * @as(f64, @floatFromInt(source_rate)) / Config.sample_rate_as(f64);
+}
+
+// Plays `sub` `ratio` times faster: 2 is an octave up, 0.5 an octave down.
+pub fn ResamplerOver(comptime Sub: type) type {
+    return struct {
+        const Self = @This();
+        // At most `MAX_TAPS` - 1 samples of history are kept when refilling, plus one block from `sub`.
+        const BUF_LEN = MAX_TAPS + Config.MAX_BLOCK_SIZE;
+
+        sub_stream: Sub,
+        // Changing it takes effect at the next `reset`.
+        quality: Quality,
+        ratio: f64,
+        target: f64,
+        buf: [BUF_LEN]f32 = [_]f32 {0} ** BUF_LEN,
+        filled: usize = 0,
+        // Of the next output sample, in `buf`.
+        pos: f64 = 0,
+        // Where in `buf` the input ended, once `sub` has stopped.
+        end: ?usize = null,
+        // The quality `buf` and `pos` are laid out for.
+        active: Quality,
+
+        pub fn init(quality: Quality, ratio: f64, sub_stream: Sub) Self {
+            var self = Self { .sub_stream = sub_stream, .quality = quality, .active = quality, .ratio = ratio, .target = ratio };
+            self.restart();
+            return self;
+        }
+
+        // Glides to `ratio` over the next block, so bends and vibrato don't step.
+        pub fn set_ratio(self: *Self, ratio: f64) void {
+            std.debug.assert(ratio > 0);
+            self.target = ratio;
+        }
+
+        fn restart(self: *Self) void {
+            self.active = self.quality;
+            const half = self.active.taps() / 2;
+            // Silence before the first input sample fills the left half of the kernel.
+            @memset(&self.buf, 0);
+            self.filled = half - 1;
+            self.pos = @floatFromInt(half - 1);
+            self.end = null;
+            self.ratio = self.target;
+        }
+
+        // Drops the samples no longer under the kernel at `i` and appends a block from `sub`, or silence after it ended.
+        fn refill(self: *Self, i: usize) void {
+            const drop = @min(i + 1 - self.active.taps() / 2, self.filled);
+            std.mem.copyForwards(f32, self.buf[0 .. self.filled - drop], self.buf[drop..self.filled]);
+            self.filled -= drop;
+            self.pos -= @floatFromInt(drop);
+            if (self.end) |e| self.end = e -| drop;
+
+            const want = @min(Config.MAX_BLOCK_SIZE, BUF_LEN - self.filled);
+            const block = self.buf[self.filled..][0..want];
+            @memset(block, 0);
+            if (self.end == null) {
+                const n, const status = self.sub_stream.read(block);
+                if (status == .Stop) self.end = self.filled + n;
+            }
+            self.filled += want;
+        }
+
+        fn render(self: *Self, out: []f32, gain: f32, comptime op: Op) struct { u32, Streamer.Status } {
+            return switch (self.active) {
+                inline else => |q| self.render_as(q, out, gain, op),
+            };
+        }
+
+        fn render_as(self: *Self, comptime q: Quality, out: []f32, gain: f32, comptime op: Op) struct { u32, Streamer.Status } {
+            const K = Kernels(q);
+            const V = @Vector(K.TAPS, f32);
+            const half = K.TAPS / 2;
+            const n = out.len;
+            if (n == 0) return .{ 0, .Continue };
+            const kernels = &K.get()[band_for(@max(self.ratio, self.target))];
+            const step = (self.target - self.ratio) / @as(f64, @floatFromInt(n));
+
+            var done: usize = 0;
+            while (done < n) : (done += 1) {
+                var i: usize = @intFromFloat(self.pos);
+                while (i + half >= self.filled) {
+                    self.refill(i);
+                    i = @intFromFloat(self.pos);
+                }
+                if (self.end) |e| if (i >= e) break;
+
+                const fp: f32 = @floatCast((self.pos - @as(f64, @floatFromInt(i))) * K.PHASES_F);
+                const p = @min(@as(usize, @intFromFloat(fp)), K.PHASES - 1);
+                const w: V = @splat(fp - @as(f32, @floatFromInt(p)));
+                const a: V = kernels[p];
+                const b: V = kernels[p + 1];
+                const x: V = self.buf[i + 1 - half ..][0..K.TAPS].*;
+                const y = @reduce(.Add, (a + (b - a) * w) * x) * gain;
+                switch (op) {
+                    .write => out[done] = y,
+                    .add => out[done] += y,
+                }
+                self.pos += self.ratio;
+                self.ratio += step;
+            }
+            if (done < n) {
+                if (op == .write) @memset(out[done..], 0);
+                return .{ @intCast(done), .Stop };
+            }
+            self.ratio = self.target;
+            return .{ @intCast(n), .Continue };
+        }
+
+        pub fn read(self: *Self, frames: []f32) struct { u32, Streamer.Status } {
+            return self.render(frames, 1, .write);
+        }
+
+        pub fn read_add(self: *Self, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+            return self.render(out, gain, .add);
+        }
+
+        pub fn reset(self: *Self) bool {
+            self.restart();
+            return self.sub_stream.reset();
+        }
+
+        pub fn streamer(self: *Self) Streamer {
+            return Streamer.make(Self, self);
+        }
+    };
+}
+
+pub const Resampler = ResamplerOver(Streamer);
+
+test "kernels pass DC and a 1:1 ratio plays the input back" {
+    const Const = struct {
+        fn read(_: *@This(), frames: []f32) struct { u32, Streamer.Status } {
+            @memset(frames, 0.5);
+            return .{ @intCast(frames.len), .Continue };
+        }
+    };
+    var r = ResamplerOver(Const).init(.Medium, 1, .{});
+    var out: [64]f32 = undefined;
+    for (0..3) |_| _ = r.read(&out);
+    for (out) |x| try std.testing.expectApproxEqAbs(@as(f32, 0.5), x, 1e-5);
+    r.set_ratio(1.5);
+    for (0..3) |_| _ = r.read(&out);
+    for (out) |x| try std.testing.expectApproxEqAbs(@as(f32, 0.5), x, 1e-5);
+}
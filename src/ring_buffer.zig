@@ -1,4 +1,5 @@
 const std = @import("std");
+const builtin = @import("builtin");
 
 pub fn FixedRingBuffer(comptime T: type, comptime size: u32) type {
     return struct {
@@ -101,3 +102,212 @@ pub fn RingBuffer(comptime T: type) type {
         }
     };
 }
+
+// Bounded multi-producer, single-consumer queue (after Vyukov's bounded queue).
+// `push` may be called from any thread and is wait-free: it reserves room with one `fetchAdd` on `count`
+// and claims its slot with one `fetchAdd` on `tail`, so it never retries, whatever the other producers do.
+// `pop` must only be called from one thread, and is wait-free.
+pub fn MpscQueue(comptime T: type, comptime size: u32) type {
+    std.debug.assert(std.math.isPowerOfTwo(size));
+    const Atomic = std.atomic.Value;
+    return struct {
+        const Self = @This();
+        const Slot = struct {
+            // `pos` when the slot is free to be written for position `pos`,
+            // `pos + 1` once it holds the value for position `pos`.
+            seq: Atomic(u32),
+            value: T,
+        };
+        slots: [size]Slot = blk: {
+            var slots: [size]Slot = undefined;
+            for (&slots, 0..) |*slot, i| slot.seq = .init(i);
+            break :blk slots;
+        },
+        tail: Atomic(u32) = .init(0), // next position to write, shared by producers
+        // Slots reserved by producers and not yet freed by the consumer; at most `size` succeed.
+        count: Atomic(u32) = .init(0),
+        head: u32 = 0, // next position to read, owned by the consumer
+
+        pub fn push(self: *Self, el: T) error{QueueFull}!void {
+            if (self.count.fetchAdd(1, .acquire) >= size) {
+                _ = self.count.fetchSub(1, .monotonic);
+                return error.QueueFull;
+            }
+            // With room reserved, the slot of the claimed position has already been freed by `pop`: whoever
+            // reserved last among the claims up to ours saw that free, and `tail`'s acq_rel chain passes it on.
+            const pos = self.tail.fetchAdd(1, .acq_rel);
+            const slot = &self.slots[pos % size];
+            std.debug.assert(slot.seq.load(.acquire) == pos);
+            slot.value = el;
+            slot.seq.store(pos +% 1, .release);
+        }
+
+        pub fn pop(self: *Self) ?T {
+            const slot = &self.slots[self.head % size];
+            if (slot.seq.load(.acquire) != self.head +% 1) return null;
+            const el = slot.value;
+            slot.seq.store(self.head +% size, .release);
+            self.head +%= 1;
+            _ = self.count.fetchSub(1, .release);
+            return el;
+        }
+    };
+}
+
+// Single-producer, single-consumer ring for moving blocks of `T` between two threads, e.g. audio
+// read ahead by a loader thread. Neither side ever blocks or takes a lock: the producer only advances
+// `write_pos` and the consumer only `read_pos`. Positions run freely and wrap; their difference is the fill level.
+pub fn SpscRing(comptime T: type) type {
+    const Atomic = std.atomic.Value;
+    return struct {
+        const Self = @This();
+        data: []T,
+        write_pos: Atomic(usize) = .init(0),
+        read_pos: Atomic(usize) = .init(0),
+
+        pub fn init(a: std.mem.Allocator, capacity: usize) !Self {
+            std.debug.assert(capacity != 0);
+            return .{ .data = try a.alloc(T, capacity) };
+        }
+
+        pub fn deinit(self: *Self, a: std.mem.Allocator) void {
+            a.free(self.data);
+        }
+
+        // Consumer side.
+        pub fn readable(self: *const Self) usize {
+            return self.write_pos.load(.acquire) -% self.read_pos.load(.monotonic);
+        }
+
+        // Producer side.
+        pub fn writable(self: *const Self) usize {
+            return self.data.len - (self.write_pos.load(.monotonic) -% self.read_pos.load(.acquire));
+        }
+
+        // Producer side: the free space, as up to two contiguous regions. Fill them from the front, then `commit`.
+        pub fn write_regions(self: *Self) [2][]T {
+            const start = self.write_pos.load(.monotonic) % self.data.len;
+            const len = self.writable();
+            const first = @min(len, self.data.len - start);
+            return .{ self.data[start..][0..first], self.data[0 .. len - first] };
+        }
+
+        pub fn commit(self: *Self, n: usize) void {
+            std.debug.assert(n <= self.writable());
+            _ = self.write_pos.fetchAdd(n, .release);
+        }
+
+        // Producer side. Returns how many of `items` fit.
+        pub fn write(self: *Self, items: []const T) usize {
+            const regions = self.write_regions();
+            const n = @min(items.len, regions[0].len + regions[1].len);
+            const first = @min(n, regions[0].len);
+            @memcpy(regions[0][0..first], items[0..first]);
+            @memcpy(regions[1][0 .. n - first], items[first..n]);
+            self.commit(n);
+            return n;
+        }
+
+        // Consumer side. Returns how many items were read into `out`.
+        pub fn read(self: *Self, out: []T) usize {
+            const pos = self.read_pos.load(.monotonic);
+            const n = @min(out.len, self.readable());
+            const start = pos % self.data.len;
+            const first = @min(n, self.data.len - start);
+            @memcpy(out[0..first], self.data[start..][0..first]);
+            @memcpy(out[first..n], self.data[0 .. n - first]);
+            self.read_pos.store(pos +% n, .release);
+            return n;
+        }
+
+        // Consumer side: drops everything written before the producer's position `pos`.
+        pub fn skip_to(self: *Self, pos: usize) void {
+            self.read_pos.store(pos, .release);
+        }
+    };
+}
+
+test "MpscQueue delivers every push once, in order per producer, through a full queue" {
+    if (builtin.single_threaded) return error.SkipZigTest;
+    const PRODUCERS = 4;
+    const PER_PRODUCER = 20_000;
+    const Item = struct { producer: u32, seq: u32 };
+    const Queue = MpscQueue(Item, 8);
+    const Producer = struct {
+        fn run(q: *Queue, id: u32, fulls: *std.atomic.Value(u32)) void {
+            var seq: u32 = 0;
+            while (seq < PER_PRODUCER) {
+                q.push(.{ .producer = id, .seq = seq }) catch {
+                    _ = fulls.fetchAdd(1, .monotonic);
+                    std.atomic.spinLoopHint();
+                    continue;
+                };
+                seq += 1;
+            }
+        }
+    };
+
+    var q = Queue {};
+    var fulls = std.atomic.Value(u32).init(0);
+    var threads: [PRODUCERS]std.Thread = undefined;
+    for (&threads, 0..) |*t, id| t.* = try std.Thread.spawn(.{}, Producer.run, .{ &q, @as(u32, @intCast(id)), &fulls });
+    // Nothing is popped until a producer has been turned away.
+    while (fulls.load(.monotonic) == 0) std.atomic.spinLoopHint();
+
+    // Mismatches are counted rather than returned, so the producers can always finish and be joined.
+    var next = [_]u32 {0} ** PRODUCERS;
+    var out_of_order: usize = 0;
+    var received: usize = 0;
+    while (received < PRODUCERS * PER_PRODUCER) {
+        const item = q.pop() orelse {
+            std.atomic.spinLoopHint();
+            continue;
+        };
+        if (item.seq != next[item.producer]) out_of_order += 1;
+        next[item.producer] = item.seq + 1;
+        received += 1;
+    }
+    for (threads) |t| t.join();
+
+    try std.testing.expectEqual(0, out_of_order);
+    try std.testing.expectEqual(null, q.pop());
+    for (next) |n| try std.testing.expectEqual(PER_PRODUCER, n);
+}
+
+test "SpscRing wraps around and reads partially" {
+    const a = std.testing.allocator;
+    var ring = try SpscRing(u32).init(a, 5);
+    defer ring.deinit(a);
+    try std.testing.expectEqual(5, ring.write(&.{ 1, 2, 3, 4, 5, 6 }));
+    try std.testing.expectEqual(0, ring.writable());
+
+    var out: [3]u32 = undefined;
+    try std.testing.expectEqual(3, ring.read(&out));
+    try std.testing.expectEqualSlices(u32, &.{ 1, 2, 3 }, &out);
+    try std.testing.expectEqual(3, ring.write(&.{ 7, 8, 9 }));
+
+    var all: [8]u32 = undefined;
+    try std.testing.expectEqual(5, ring.read(&all));
+    try std.testing.expectEqualSlices(u32, &.{ 4, 5, 7, 8, 9 }, all[0..5]);
+    try std.testing.expectEqual(0, ring.readable());
+    try std.testing.expectEqual(0, ring.read(&all));
+    // Empty with the position at 3: the free space runs to the end of `data`, then from its start.
+    const regions = ring.write_regions();
+    try std.testing.expectEqual(2, regions[0].len);
+    try std.testing.expectEqual(3, regions[1].len);
+}
+
+test "SpscRing.skip_to drops stale data" {
+    const a = std.testing.allocator;
+    var ring = try SpscRing(u32).init(a, 8);
+    defer ring.deinit(a);
+    _ = ring.write(&.{ 1, 2, 3, 4 });
+    var out: [1]u32 = undefined;
+    _ = ring.read(&out);
+    const mark = ring.write_pos.load(.monotonic);
+    _ = ring.write(&.{ 10, 11 });
+    ring.skip_to(mark);
+    var rest: [8]u32 = undefined;
+    try std.testing.expectEqual(2, ring.read(&rest));
+    try std.testing.expectEqualSlices(u32, &.{ 10, 11 }, rest[0..2]);
+}
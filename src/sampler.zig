@@ -0,0 +1,290 @@
+//! Playback of recorded audio from memory-mapped files.
+//! A `Sample` maps a WAV or raw PCM file read-only and faults every page in at load time (optionally
+//! locking them), so the audio thread reads straight from the page cache and never waits on the disk.
+//! Many `Player`s can share one `Sample`; each only keeps a position.
+//! Samples play at their recorded rate, i.e. off pitch when it differs from `Config.sample_rate`;
+//! a `Resampler` around the player repitches it (see `Resampler.ratio_for`).
+const std = @import("std");
+const posix = std.posix;
+
+const Streamer = @import("streamer.zig");
+const Config = @import("config.zig");
+
+pub const Encoding = enum {
+    i16,
+    i24,
+    i32,
+    f32,
+
+    pub fn bytes(self: Encoding) u16 {
+        return switch (self) {
+            .i16 => 2,
+            .i24 => 3,
+            .i32, .f32 => 4,
+        };
+    }
+};
+
+// Samples are always little-endian and interleaved.
+pub const Layout = struct {
+    encoding: Encoding,
+    channels: u16,
+    rate: u32,
+};
+
+pub const LoadOptions = struct {
+    // Also `mlock` the pages, so they can't be evicted under memory pressure. Subject to RLIMIT_MEMLOCK.
+    lock: bool = false,
+};
+
+pub const Error = error{ InvalidWav, UnsupportedFormat, LockFailed };
+
+const Op = Streamer.Op;
+
+extern "c" fn mlock(addr: *const anyopaque, len: usize) c_int;
+
+pub const Sample = struct {
+    map: []align(std.heap.page_size_min) u8,
+    pcm: []const u8, // the audio frames, within `map`
+    layout: Layout,
+    frames: u64,
+
+    pub fn open_wav(path: []const u8, opts: LoadOptions) !Sample {
+        const map = try map_file(path);
+        errdefer posix.munmap(map);
+        const pcm, const layout = try parse_wav(map);
+        return init(map, pcm, layout, opts);
+    }
+
+    // Headerless PCM; the whole file is audio.
+    pub fn open_raw(path: []const u8, layout: Layout, opts: LoadOptions) !Sample {
+        const map = try map_file(path);
+        errdefer posix.munmap(map);
+        return init(map, map, layout, opts);
+    }
+
+    fn init(map: []align(std.heap.page_size_min) u8, pcm: []const u8, layout: Layout, opts: LoadOptions) !Sample {
+        if (layout.channels == 0) return error.UnsupportedFormat;
+        try prefault(map, opts.lock);
+        const stride = @as(usize, layout.encoding.bytes()) * layout.channels;
+        return .{ .map = map, .pcm = pcm, .layout = layout, .frames = pcm.len / stride };
+    }
+
+    pub fn close(self: *Sample) void {
+        posix.munmap(self.map);
+    }
+
+    pub fn frame_bytes(self: *const Sample) usize {
+        return @as(usize, self.layout.encoding.bytes()) * self.layout.channels;
+    }
+
+    // Writes (or adds) `gain` times `out.len` frames from `frame` on into `out`:
+    // channel `channel`, or the average of all channels when it is null.
+    fn decode(self: *const Sample, frame: u64, channel: ?u16, out: []f32, gain: f32, comptime op: Op) void {
+        switch (self.layout.encoding) {
+            inline else => |enc| self.decode_as(enc, frame, channel, out, gain, op),
+        }
+    }
+
+    fn decode_as(self: *const Sample, comptime enc: Encoding, frame: u64, channel: ?u16, out: []f32, gain: f32, comptime op: Op) void {
+        const size = comptime enc.bytes();
+        const stride = self.frame_bytes();
+        const base = self.pcm[@intCast(frame * stride)..];
+        const first: u16, const count: u16 = if (channel) |ch| .{ ch, 1 } else .{ 0, self.layout.channels };
+        const scale = gain / @as(f32, @floatFromInt(count));
+        for (out, 0..) |*o, i| {
+            var sum: f32 = 0;
+            for (first..first + count) |ch| sum += value(enc, base[i * stride + ch * size ..][0..size]);
+            switch (op) {
+                .write => o.* = sum * scale,
+                .add => o.* += sum * scale,
+            }
+        }
+    }
+};
+
+fn value(comptime enc: Encoding, bytes: *const [enc.bytes()]u8) f32 {
+    return switch (enc) {
+        .i16 => @as(f32, @floatFromInt(std.mem.readInt(i16, bytes, .little))) / (1 << 15),
+        .i24 => @as(f32, @floatFromInt(std.mem.readInt(i24, bytes, .little))) / (1 << 23),
+        .i32 => @as(f32, @floatFromInt(std.mem.readInt(i32, bytes, .little))) / (1 << 31),
+        .f32 => @bitCast(std.mem.readInt(u32, bytes, .little)),
+    };
+}
+
+fn map_file(path: []const u8) ![]align(std.heap.page_size_min) u8 {
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+    const len = (try file.stat()).size;
+    if (len == 0) return error.UnsupportedFormat;
+    return posix.mmap(null, @intCast(len), posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0);
+}
+
+// Brings every page into memory now, so that playing never faults.
+fn prefault(map: []align(std.heap.page_size_min) u8, lock: bool) !void {
+    posix.madvise(map.ptr, map.len, posix.MADV.WILLNEED) catch {};
+    const page = std.heap.pageSize();
+    var i: usize = 0;
+    while (i < map.len) : (i += page) {
+        _ = @as(*volatile const u8, &map[i]).*;
+    }
+    if (lock and mlock(map.ptr, map.len) != 0) return error.LockFailed;
+}
+
+pub const WavInfo = struct {
+    layout: Layout,
+    offset: usize, // of the first frame
+    len: ?u64, // bytes of audio; null when the writer left it unknown, i.e. to the end of the file
+};
+
+// Reads the format and the position of the audio data in a RIFF/WAVE file.
+// `bytes` may be just the start of the file, as long as it reaches the data chunk.
+pub fn parse_wav_header(bytes: []const u8) Error!WavInfo {
+    if (bytes.len < 12 or !std.mem.eql(u8, bytes[0..4], "RIFF") or !std.mem.eql(u8, bytes[8..12], "WAVE")) return error.InvalidWav;
+    var layout: ?Layout = null;
+    var pos: usize = 12;
+    while (pos + 8 <= bytes.len) {
+        const id = bytes[pos..][0..4];
+        const size = std.mem.readInt(u32, bytes[pos + 4 ..][0..4], .little);
+        const body = bytes[pos + 8 .. @min(pos + 8 + size, bytes.len)];
+        if (std.mem.eql(u8, id, "fmt ")) {
+            if (body.len < 16) return error.InvalidWav;
+            var tag = std.mem.readInt(u16, body[0..2], .little);
+            // WAVE_FORMAT_EXTENSIBLE: the real tag leads the subformat GUID.
+            if (tag == 0xFFFE and body.len >= 26) tag = std.mem.readInt(u16, body[24..26], .little);
+            const bits = std.mem.readInt(u16, body[14..16], .little);
+            layout = .{
+                .encoding = switch (tag) {
+                    1 => switch (bits) {
+                        16 => .i16,
+                        24 => .i24,
+                        32 => .i32,
+                        else => return error.UnsupportedFormat,
+                    },
+                    3 => if (bits == 32) .f32 else return error.UnsupportedFormat,
+                    else => return error.UnsupportedFormat,
+                },
+                .channels = std.mem.readInt(u16, body[2..4], .little),
+                .rate = std.mem.readInt(u32, body[4..8], .little),
+            };
+        } else if (std.mem.eql(u8, id, "data")) {
+            // A length left unknown by a streaming writer means "to the end of the file".
+            return .{
+                .layout = layout orelse return error.InvalidWav,
+                .offset = pos + 8,
+                .len = if (size == 0xFFFF_FFFF) null else size,
+            };
+        }
+        pos += 8 + @as(usize, size) + (size & 1);
+    }
+    return error.InvalidWav;
+}
+
+fn parse_wav(bytes: []const u8) Error!struct { []const u8, Layout } {
+    const info = try parse_wav_header(bytes);
+    const end: usize = if (info.len) |len| @intCast(@min(bytes.len, info.offset + len)) else bytes.len;
+    return .{ bytes[info.offset..end], info.layout };
+}
+
+// Converts interleaved samples in `encoding` to f32, filling `out`.
+pub fn decode_interleaved(encoding: Encoding, bytes: []const u8, out: []f32) void {
+    switch (encoding) {
+        inline else => |enc| {
+            const size = comptime enc.bytes();
+            std.debug.assert(bytes.len >= out.len * size);
+            for (out, 0..) |*o, i| o.* = value(enc, bytes[i * size ..][0..size]);
+        },
+    }
+}
+
+// Which frames of a sample a `Player` plays.
+pub const Region = struct {
+    start: u64 = 0,
+    end: ?u64 = null, // null: the end of the sample
+    loop_start: ?u64 = null, // null: stop at `end`
+};
+
+// Plays frames `start..end` of a sample, then either stops or jumps back to `loop_start`.
+pub const Player = struct {
+    sample: *const Sample,
+    gain: f32,
+    start: u64,
+    end: u64,
+    loop_start: ?u64,
+    pos: u64,
+
+    // Ready to play from `region.start`, so it can go straight to `Mixer.play` without a `reset`.
+    pub fn init(sample: *const Sample, gain: f32, region: Region) Player {
+        const end = region.end orelse sample.frames;
+        std.debug.assert(region.start < end and end <= sample.frames);
+        if (region.loop_start) |loop_start| std.debug.assert(loop_start < end);
+        return .{
+            .sample = sample,
+            .gain = gain,
+            .start = region.start,
+            .end = end,
+            .loop_start = region.loop_start,
+            .pos = region.start,
+        };
+    }
+
+    // `channel` null mixes every channel of the sample down.
+    fn render(self: *Player, out: []f32, channel: ?u16, gain: f32, comptime op: Op) struct { u32, Streamer.Status } {
+        var done: usize = 0;
+        while (done < out.len) {
+            if (self.pos >= self.end) {
+                self.pos = self.loop_start orelse break;
+            }
+            const n: usize = @intCast(@min(out.len - done, self.end - self.pos));
+            self.sample.decode(self.pos, channel, out[done..][0..n], gain, op);
+            self.pos += n;
+            done += n;
+        }
+        if (done < out.len) {
+            if (op == .write) @memset(out[done..], 0);
+            return .{ @intCast(done), .Stop };
+        }
+        return .{ @intCast(out.len), .Continue };
+    }
+
+    pub fn read(self: *Player, frames: []f32) struct { u32, Streamer.Status } {
+        return self.render(frames, null, self.gain, .write);
+    }
+
+    pub fn read_add(self: *Player, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+        return self.render(out, null, self.gain * gain, .add);
+    }
+
+    // Each output channel takes the sample's channel of the same index; a mono sample feeds them all.
+    pub fn read_planar(self: *Player, channels: []const []f32) struct { u32, Streamer.Status } {
+        const pos = self.pos;
+        var result: struct { u32, Streamer.Status } = .{ 0, .Stop };
+        for (channels, 0..) |out, ch| {
+            self.pos = pos;
+            const last = self.sample.layout.channels - 1;
+            result = self.render(out, @as(u16, @intCast(@min(ch, last))), self.gain, .write);
+        }
+        return result;
+    }
+
+    pub fn reset(self: *Player) bool {
+        self.pos = self.start;
+        return true;
+    }
+
+    pub fn streamer(self: *Player) Streamer {
+        return Streamer.make(Player, self);
+    }
+};
+
+test "parse_wav finds the data chunk" {
+    const wav = "RIFF" ++ "\x00\x00\x00\x00" ++ "WAVE" ++
+        "fmt " ++ "\x10\x00\x00\x00" ++ "\x01\x00" ++ "\x02\x00" ++ "\x44\xac\x00\x00" ++ "\x10\xb1\x02\x00" ++ "\x04\x00" ++ "\x10\x00" ++
+        "LIST" ++ "\x03\x00\x00\x00" ++ "abc\x00" ++
+        "data" ++ "\x04\x00\x00\x00" ++ "\x00\x40\x00\xc0";
+    const pcm, const layout = try parse_wav(wav);
+    try std.testing.expectEqual(Layout { .encoding = .i16, .channels = 2, .rate = 44100 }, layout);
+    try std.testing.expectEqualSlices(u8, "\x00\x40\x00\xc0", pcm);
+    try std.testing.expectEqual(@as(f32, 0.5), value(.i16, pcm[0..2]));
+    try std.testing.expectEqual(@as(f32, -0.5), value(.i16, pcm[2..4]));
+}
@@ -1,12 +1,19 @@
 const std = @import("std");
+const Config = @import("config.zig");
 const Streamer = @This();
 
+pub const VEC_LEN = std.simd.suggestVectorLength(f32) orelse 4;
+pub const Vec = @Vector(VEC_LEN, f32);
+
 pub const Status = enum(u8) {
     Stop = 0,
     Continue = 1,
     pub fn andStatus(self: Status, other: Status) Status {
         return @enumFromInt(@intFromEnum(self) & @intFromEnum(other));
     }
+    pub fn orStatus(self: Status, other: Status) Status {
+        return @enumFromInt(@intFromEnum(self) | @intFromEnum(other));
+    }
 };
 ptr: *anyopaque,
 vtable: VTable,
@@ -15,6 +22,12 @@ pub const VTable = struct {
     read: *const fn(self: *anyopaque, frames: []f32) struct { u32, Status },
     reset: *const fn(self: *anyopaque) bool,
     stop: *const fn(self: *anyopaque) bool = stop_noop,
+    // Only for nodes that produce more than one channel. Each slice in `channels` is one channel's
+    // contiguous buffer (planar layout), all of the same length; see `read_planar`.
+    read_planar: ?*const fn(self: *anyopaque, channels: []const []f32) struct { u32, Status } = null,
+    // For nodes that can add `gain` times their output straight into `out` instead of overwriting it;
+    // see `read_add`.
+    read_add: ?*const fn(self: *anyopaque, out: []f32, gain: f32) struct { u32, Status } = null,
 
 
     pub fn stop_noop(self: *anyopaque) bool { 
@@ -27,6 +40,58 @@ pub fn read(self: Streamer, frames: []f32) struct { u32, Status } {
     return self.vtable.read(self.ptr, frames);
 }
 
+// Reads one block of planar audio. A mono node is read into the first channel and copied to the rest;
+// callers that can use the mono signal directly should check `is_planar` and skip the copies.
+pub fn read_planar(self: Streamer, channels: []const []f32) struct { u32, Status } {
+    if (self.vtable.read_planar) |read_planar_fn| return read_planar_fn(self.ptr, channels);
+    const len, const status = self.read(channels[0]);
+    for (channels[1..]) |channel| @memcpy(channel, channels[0]);
+    return .{ len, status };
+}
+
+// Adds `gain` times the next `out.len` frames into `out`, which may already hold other voices.
+// Summing nodes (`Mixer`, `KeyBoard`, `Graph.Mix`) use this so that voices with a native `read_add`
+// write into the shared buffer directly; other voices go through a scratch block.
+pub fn read_add(self: Streamer, out: []f32, gain: f32) struct { u32, Status } {
+    if (self.vtable.read_add) |read_add_fn| return read_add_fn(self.ptr, out, gain);
+    return read_then_add(self, out, gain);
+}
+
+// Same as `read_add`, for a concrete node held by value.
+pub fn read_add_of(comptime T: type, node: *T, out: []f32, gain: f32) struct { u32, Status } {
+    if (@hasDecl(T, "read_add")) return node.read_add(out, gain);
+    return read_then_add(node, out, gain);
+}
+
+fn read_then_add(node: anytype, out: []f32, gain: f32) struct { u32, Status } {
+    var tmp: [Config.MAX_BLOCK_SIZE]f32 = undefined;
+    std.debug.assert(tmp.len >= out.len);
+    @memset(tmp[0..out.len], 0);
+    const len, const status = node.read(tmp[0..out.len]);
+    add_scaled(out[0..len], tmp[0..len], gain);
+    return .{ len, status };
+}
+
+// Whether a node's inner `render` overwrites its output (`read`) or adds to it (`read_add`).
+pub const Op = enum { write, add };
+
+// out += gain * in
+pub fn add_scaled(out: []f32, in: []const f32, gain: f32) void {
+    std.debug.assert(out.len == in.len);
+    const g: Vec = @splat(gain);
+    var i: usize = 0;
+    while (i + VEC_LEN <= out.len) : (i += VEC_LEN) {
+        const o: Vec = out[i..][0..VEC_LEN].*;
+        const x: Vec = in[i..][0..VEC_LEN].*;
+        out[i..][0..VEC_LEN].* = o + x * g;
+    }
+    while (i < out.len) : (i += 1) out[i] += in[i] * gain;
+}
+
+pub fn is_planar(self: Streamer) bool {
+    return self.vtable.read_planar != null;
+}
+
 pub fn reset(self: Streamer) bool {
     return self.vtable.reset(self.ptr);
 }
@@ -35,16 +100,23 @@ pub fn stop(self: Streamer) bool {
     return self.vtable.stop(self.ptr);
 } 
 
+// Type-erases a concrete node.
+// `T` must have `pub fn read(self: *T, frames: []f32) struct { u32, Status }`,
+// and may have `pub fn reset(self: *T) bool`, `pub fn stop(self: *T) bool`,
+// `pub fn read_planar(self: *T, channels: []const []f32) struct { u32, Status }` and
+// `pub fn read_add(self: *T, out: []f32, gain: f32) struct { u32, Status }`.
+// Nodes written this way can also be nested by value inside other nodes (see `graph.zig`),
+// in which case the calls between them are direct and erasure happens only here.
 pub fn make(comptime T: type, val: *T) Streamer {
     if (!@hasDecl(T, "read")) {
-        @compileError(@typeName(T) ++ " does not have method `play`");
+        @compileError(@typeName(T) ++ " does not have method `read`");
     }
     
     const wrapper = struct {
         pub fn read(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
             const unwrapped: *T = @ptrCast(@alignCast(ptr));
             return unwrapped.read(frames);
-}
+        }
 
         pub fn reset(ptr: *anyopaque) bool {
             if (@hasDecl(T, "reset")) {
@@ -57,11 +129,27 @@ pub fn make(comptime T: type, val: *T) Streamer {
         pub fn stop(ptr: *anyopaque) bool {
             if (@hasDecl(T, "stop")) {
                 const unwrapped: *T = @ptrCast(@alignCast(ptr));
-                return unwrapped.reset(); 
+                return unwrapped.stop(); 
             }
             return false;
         }
+
+        pub fn read_planar(ptr: *anyopaque, channels: []const []f32) struct { u32, Streamer.Status } {
+            const unwrapped: *T = @ptrCast(@alignCast(ptr));
+            return unwrapped.read_planar(channels);
+        }
+
+        pub fn read_add(ptr: *anyopaque, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+            const unwrapped: *T = @ptrCast(@alignCast(ptr));
+            return unwrapped.read_add(out, gain);
+        }
     };
    
-    return Streamer { .ptr = @ptrCast(val), .vtable = .{ .read = wrapper.read, .reset = wrapper.reset, .stop = wrapper.stop } };
+    return Streamer { .ptr = @ptrCast(val), .vtable = .{
+        .read = wrapper.read,
+        .reset = wrapper.reset,
+        .stop = wrapper.stop,
+        .read_planar = if (@hasDecl(T, "read_planar")) wrapper.read_planar else null,
+        .read_add = if (@hasDecl(T, "read_add")) wrapper.read_add else null,
+    } };
 }
@@ -0,0 +1,406 @@
+// Micro-benchmarks for every Streamer node, built by `zig build bench -- [options]`.
+// Nodes are pulled directly, exactly like the device callback would, so no audio device is opened
+// and the suite runs on headless machines. Use `-Doptimize=ReleaseFast` for meaningful numbers.
+//
+// Output is CSV on stdout: one row per (node, block size) with the cost per sample and
+// how many such voices a single core could keep up with in real time at `--rate`. The block size is the
+// callback period; periods above `Config.MAX_BLOCK_SIZE` are split the same way the engine splits them.
+const std = @import("std");
+
+const Zynth = @import("zynth");
+const Waveform = Zynth.Waveform;
+const Wavetable = Zynth.Wavetable;
+const Envelop = Zynth.Envelop;
+const Delay = Zynth.Delay;
+const Modulate = Zynth.Modulate;
+const Noise = Zynth.Noise;
+const Filter = Zynth.Filter;
+const Mixer = Zynth.Mixer;
+const Replay = Zynth.Replay;
+const Config = Zynth.Config;
+const Streamer = Zynth.Streamer;
+const WorkerPool = Zynth.WorkerPool;
+const Preset = @import("preset");
+
+const create = Zynth.Audio.create;
+
+const usage =
+    \\usage: bench [options]
+    \\  -f, --filter <prefix>  only run nodes whose name starts with <prefix>
+    \\  -n, --samples <count>  samples rendered per measurement (default: 4 seconds of audio)
+    \\  -r, --rate <hz>        sample rate the nodes run at (default: 44100)
+    \\
+;
+
+const MIN_BLOCK = 32;
+const MAX_BLOCK = 4096;
+
+var streams = Noise.Streams.init(0);
+
+const Case = struct {
+    name: []const u8,
+    setup: *const fn (a: std.mem.Allocator) anyerror!Streamer,
+};
+
+fn sine(a: std.mem.Allocator, freq: f64) Streamer {
+    return create(a, Waveform.Simple.init(0.5, freq, .Sine)).streamer();
+}
+
+fn simple(comptime shape: Waveform.Shape, comptime band_limited: bool) Case {
+    return .{ .name = "Simple." ++ @tagName(shape) ++ if (band_limited) ".bl" else "", .setup = struct {
+        fn setup(a: std.mem.Allocator) anyerror!Streamer {
+            var osc = Waveform.Simple.init(0.5, 440, shape);
+            osc.band_limited = band_limited;
+            return create(a, osc).streamer();
+        }
+    }.setup };
+}
+
+// The per-sample function pointer loop `Simple` used before its vectorized kernels, kept as the baseline.
+const ScalarSimple = struct {
+    osc: Waveform.Simple,
+    time: f64 = 0,
+
+    pub fn read(self: *ScalarSimple, frames: []f32) struct { u32, Streamer.Status } {
+        const func = self.osc.shape.get_wave_func();
+        const advance = Waveform.calculate_advance(Config.sample_rate, self.osc.frequency);
+        for (frames) |*x| {
+            self.time += advance;
+            x.* = func(self.time) * self.osc.amplitude;
+        }
+        return .{ @intCast(frames.len), .Continue };
+    }
+
+    pub fn streamer(self: *ScalarSimple) Streamer {
+        return Streamer.make(ScalarSimple, self);
+    }
+};
+
+fn scalar_simple(comptime shape: Waveform.Shape) Case {
+    return .{ .name = "Simple." ++ @tagName(shape) ++ ".scalar", .setup = struct {
+        fn setup(a: std.mem.Allocator) anyerror!Streamer {
+            return create(a, ScalarSimple { .osc = Waveform.Simple.init(0.5, 440, shape) }).streamer();
+        }
+    }.setup };
+}
+
+fn wavetable(comptime shape: Waveform.Shape) Case {
+    return .{ .name = "Wavetable." ++ @tagName(shape), .setup = struct {
+        fn setup(a: std.mem.Allocator) anyerror!Streamer {
+            return create(a, Wavetable.Oscillator.init(0.5, 440, shape)).streamer();
+        }
+    }.setup };
+}
+
+fn drum(comptime name: []const u8, comptime preset: anytype) Case {
+    return .{ .name = "Drum." ++ name, .setup = struct {
+        // Retrigger every half second, like the drum example does.
+        fn setup(a: std.mem.Allocator) anyerror!Streamer {
+            return create(a, Replay.Repeat.init_secs(0.5, null, try preset(a))).streamer();
+        }
+    }.setup };
+}
+
+fn freq_envelop(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Waveform.FreqEnvelop.init(0.5, .init(
+        try a.dupe(f64, &.{3600}),
+        try a.dupe(f64, &.{300, 50}),
+    ), .Sine)).streamer();
+}
+
+fn white_noise(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Waveform.WhiteNoise.init(0.5, streams.next())).streamer();
+}
+
+fn pink_noise(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Noise.Pink.init(0.5, streams.next())).streamer();
+}
+
+fn velvet_noise(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Noise.Velvet.init(0.5, 2000, streams.next())).streamer();
+}
+
+fn brown_noise(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Waveform.BrownNoise {.white = .init(0.5, streams.next()), .rc = 0.1 }).streamer();
+}
+
+fn string_noise(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Waveform.StringNoise.init(0.5, 220, null)).streamer();
+}
+
+fn envelop(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Envelop.Envelop(.{ .static = 3 }).init(.{0.01, 3600}, .{0, 1, 0}, sine(a, 440))).streamer();
+}
+
+fn live_envelop(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Envelop.LiveEnvelop.init(0.05, 0.03, 0.1, sine(a, 440))).streamer();
+}
+
+fn live_envelop_curved(a: std.mem.Allocator) anyerror!Streamer {
+    const params = Envelop.Adsr.Params { .attack = 0.05, .decay = 0.03, .release = 0.1, .attack_curve = -2, .curve = 4 };
+    return create(a, Envelop.LiveEnvelop.init_params(params, sine(a, 440))).streamer();
+}
+
+fn delay(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Delay.Delay.init_secs(0.25, 0.5, sine(a, 440))).streamer();
+}
+
+fn reverb(a: std.mem.Allocator) anyerror!Streamer {
+    const secs = .{0.11, 0.13, 0.17, 0.19, 0.23, 0.29, 0.31, 0.37, 0.41, 0.43};
+    return create(a, Delay.Reverb.init_secs(secs, 0.3, sine(a, 440))).streamer();
+}
+
+fn ring_modulater(a: std.mem.Allocator) anyerror!Streamer {
+    return create(a, Modulate.RingModulater {.carrier = sine(a, 440), .modulator = sine(a, 30)}).streamer();
+}
+
+fn biquad(a: std.mem.Allocator) anyerror!Streamer {
+    const saw = create(a, Waveform.Simple.init(0.5, 110, .Sawtooth)).streamer();
+    return create(a, Filter.Biquad.init(.{ .kind = .LowPass, .freq = 800, .q = 2 }, saw)).streamer();
+}
+
+fn svf(a: std.mem.Allocator) anyerror!Streamer {
+    const saw = create(a, Waveform.Simple.init(0.5, 110, .Sawtooth)).streamer();
+    return create(a, Filter.Svf.init(.{ .kind = .LowPass, .freq = 800, .q = 2 }, saw)).streamer();
+}
+
+// Eight sawtooth voices, each through its own low-pass, either one filter at a time or as one `SvfBank`.
+fn FilteredVoices(comptime banked: bool) type {
+    return struct {
+        const Self = @This();
+        const N = 8;
+        saws: [N]Waveform.Simple,
+        single: [N]Filter.SvfState(f32) = .{Filter.SvfState(f32) {}} ** N,
+        bank: Filter.SvfBank(N) = .{},
+
+        fn setup(a: std.mem.Allocator) anyerror!Streamer {
+            const self = create(a, Self { .saws = undefined });
+            for (&self.saws, &self.single, 0..) |*saw, *f, i| {
+                const k: f64 = @floatFromInt(i + 1);
+                saw.* = .init(0.1, 55 * k, .Sawtooth);
+                const p = Filter.Params { .kind = .LowPass, .freq = 300 * k, .q = 2 };
+                f.load(0, p);
+                self.bank.set(i, p);
+            }
+            return Streamer.make(Self, self);
+        }
+
+        pub fn read(self: *Self, frames: []f32) struct { u32, Streamer.Status } {
+            var tmp: [N][Config.MAX_BLOCK_SIZE]f32 = undefined;
+            var bufs: [N][]f32 = undefined;
+            for (&bufs, &tmp, &self.saws) |*buf, *t, *saw| {
+                buf.* = t[0..frames.len];
+                _ = saw.read(buf.*);
+            }
+            if (banked) {
+                self.bank.process(&bufs);
+            } else {
+                for (bufs, &self.single) |buf, *f| {
+                    for (buf) |*x| x.* = f.tick(x.*);
+                }
+            }
+            @memcpy(frames, bufs[0]);
+            for (bufs[1..]) |buf| Streamer.add_scaled(frames, buf, 1);
+            return .{ @intCast(frames.len), .Continue };
+        }
+    };
+}
+
+fn fm(comptime name: []const u8, comptime params: Zynth.Fm.Params) Case {
+    return .{ .name = "Fm." ++ name, .setup = struct {
+        fn setup(a: std.mem.Allocator) anyerror!Streamer {
+            return create(a, Replay.Repeat.init_secs(0.5, null, Preset.Fm.voice(a, params, 220))).streamer();
+        }
+    }.setup };
+}
+
+// Decaying sawtooth-like spectra, retriggered like the drums so the partials keep sounding.
+fn additive(comptime partials: usize) Case {
+    const name = std.fmt.comptimePrint("Additive.Bank({d})", .{partials});
+    return .{ .name = name, .setup = struct {
+        fn setup(a: std.mem.Allocator) anyerror!Streamer {
+            const Bank = Zynth.Additive.Bank(partials);
+            const bank = create(a, Bank.init(0.2, 55, Zynth.Additive.harmonics(partials, 1, 3, 0.5)));
+            return create(a, Replay.Repeat.init_secs(0.5, null, bank.streamer())).streamer();
+        }
+    }.setup };
+}
+
+// One second of looped stereo noise, written as a float WAV, mapped back and unlinked (the mapping stays valid).
+fn looped_sample(a: std.mem.Allocator) anyerror!*Zynth.Sampler.Player {
+    const path = "zynth-bench-sample.wav";
+    {
+        const file = try std.fs.cwd().createFile(path, .{});
+        defer file.close();
+        var buf: [4096]u8 = undefined;
+        var file_writer = file.writer(&buf);
+        const w = &file_writer.interface;
+        try Zynth.Render.write_wav_header(w, Config.sample_rate);
+        var rng = streams.next();
+        for (0..Config.sample_rate * Config.CHANNELS) |_| try w.writeInt(u32, @bitCast(rng.float() * 0.5), .little);
+        try w.flush();
+    }
+    defer std.fs.cwd().deleteFile(path) catch {};
+    const sample = create(a, try Zynth.Sampler.Sample.open_wav(path, .{}));
+    return create(a, Zynth.Sampler.Player.init(sample, 0.5, .{ .loop_start = 0 }));
+}
+
+fn sampler(a: std.mem.Allocator) anyerror!Streamer {
+    return (try looped_sample(a)).streamer();
+}
+
+// A sample voice pitched up a major third, the usual distance to the nearest root in a multisample.
+fn resampler(comptime quality: Zynth.Resampler.Quality) Case {
+    const name = "Resampler(" ++ @tagName(quality) ++ ",Sampler.Player)";
+    return .{ .name = name, .setup = struct {
+        fn setup(a: std.mem.Allocator) anyerror!Streamer {
+            const player = try looped_sample(a);
+            return create(a, Zynth.Resampler.Resampler.init(quality, 1.26, player.streamer())).streamer();
+        }
+    }.setup };
+}
+
+// Shared by every parallel case, and spawned once so thread creation isn't measured.
+var pool: ?*WorkerPool = null;
+
+fn mixer(comptime voices: usize, comptime parallel: bool) Case {
+    const name = std.fmt.comptimePrint("Mixer({d}xSimple.Sine{s})", .{ voices, if (parallel) ",parallel" else "" });
+    return .{ .name = name, .setup = struct {
+        fn setup(a: std.mem.Allocator) anyerror!Streamer {
+            const m = create(a, Mixer {});
+            if (parallel) m.pool = pool orelse blk: {
+                pool = try WorkerPool.init_per_core(std.heap.page_allocator);
+                break :blk pool.?;
+            };
+            for (0..voices) |i| m.play(sine(a, 110 * @as(f64, @floatFromInt(i + 1))));
+            return m.streamer();
+        }
+    }.setup };
+}
+
+const cases = [_]Case {
+    simple(.Sine, false),
+    simple(.Triangle, false),
+    simple(.Sawtooth, false),
+    simple(.Square, false),
+    scalar_simple(.Sine),
+    scalar_simple(.Triangle),
+    scalar_simple(.Sawtooth),
+    scalar_simple(.Square),
+    simple(.Triangle, true),
+    simple(.Sawtooth, true),
+    simple(.Square, true),
+    wavetable(.Sine),
+    wavetable(.Triangle),
+    wavetable(.Sawtooth),
+    wavetable(.Square),
+    .{ .name = "FreqEnvelop", .setup = freq_envelop },
+    .{ .name = "WhiteNoise", .setup = white_noise },
+    .{ .name = "PinkNoise", .setup = pink_noise },
+    .{ .name = "VelvetNoise", .setup = velvet_noise },
+    .{ .name = "BrownNoise", .setup = brown_noise },
+    .{ .name = "StringNoise", .setup = string_noise },
+    .{ .name = "Envelop(Simple.Sine)", .setup = envelop },
+    .{ .name = "LiveEnvelop(Simple.Sine)", .setup = live_envelop },
+    .{ .name = "LiveEnvelop.curved(Simple.Sine)", .setup = live_envelop_curved },
+    .{ .name = "Delay(Simple.Sine)", .setup = delay },
+    .{ .name = "Reverb(Simple.Sine)", .setup = reverb },
+    .{ .name = "RingModulater(Simple.Sine)", .setup = ring_modulater },
+    .{ .name = "Biquad(Simple.Sawtooth)", .setup = biquad },
+    .{ .name = "Svf(Simple.Sawtooth)", .setup = svf },
+    .{ .name = "8xSvf(Simple.Sawtooth)", .setup = FilteredVoices(false).setup },
+    .{ .name = "SvfBank(8xSimple.Sawtooth)", .setup = FilteredVoices(true).setup },
+    fm("epiano", Preset.Fm.epiano),
+    fm("bell", Preset.Fm.bell),
+    additive(64),
+    additive(256),
+    .{ .name = "Sampler.Player", .setup = sampler },
+    resampler(.Low),
+    resampler(.Medium),
+    resampler(.High),
+    mixer(8, false),
+    mixer(32, false),
+    mixer(32, true),
+    drum("bass", Preset.Drum.bass),
+    drum("close_hi_hat", Preset.Drum.close_hi_hat),
+    drum("snare", Preset.Drum.snare),
+};
+
+// Pulls `total` samples through `stream`, zeroing the block before every read like the device does.
+// Graphs that finish are reset, so one-shots are measured while sounding.
+fn measure(stream: Streamer, block: []f32, total: usize) !struct { u64, usize } {
+    var done: usize = 0;
+    var timer = try std.time.Timer.start();
+    while (done < total) : (done += block.len) {
+        @memset(block, 0);
+        _, const status = Zynth.Audio.read_blocks(stream, block);
+        if (status == .Stop) _ = stream.reset();
+    }
+    const elapsed = timer.read();
+    std.mem.doNotOptimizeAway(block.ptr);
+    return .{ elapsed, done };
+}
+
+fn fail(comptime fmt: []const u8, args: anytype) noreturn {
+    std.debug.print(fmt ++ "\n" ++ usage, args);
+    std.process.exit(1);
+}
+
+pub fn main() !void {
+    var arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena.deinit();
+
+    var filter: []const u8 = "";
+    var total_opt: ?usize = null;
+
+    const args = try std.process.argsAlloc(std.heap.page_allocator);
+    defer std.process.argsFree(std.heap.page_allocator, args);
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "-h") or std.mem.eql(u8, arg, "--help")) {
+            std.debug.print(usage, .{});
+            return;
+        }
+        if (i + 1 >= args.len) fail("missing value for '{s}'", .{arg});
+        const val = args[i + 1];
+        i += 1;
+        if (std.mem.eql(u8, arg, "-f") or std.mem.eql(u8, arg, "--filter")) {
+            filter = val;
+        } else if (std.mem.eql(u8, arg, "-n") or std.mem.eql(u8, arg, "--samples")) {
+            total_opt = std.fmt.parseInt(usize, val, 10) catch fail("invalid sample count '{s}'", .{val});
+        } else if (std.mem.eql(u8, arg, "-r") or std.mem.eql(u8, arg, "--rate")) {
+            Config.sample_rate = std.fmt.parseInt(u32, val, 10) catch fail("invalid sample rate '{s}'", .{val});
+            if (Config.sample_rate == 0 or Config.sample_rate > Config.MAX_SAMPLE_RATE) fail("sample rate must be within 1..{d}", .{Config.MAX_SAMPLE_RATE});
+        } else {
+            fail("unknown option '{s}'", .{arg});
+        }
+    }
+
+    const total = total_opt orelse 4 * Config.sample_rate;
+
+    var stdout_buf: [4096]u8 = undefined;
+    var stdout = std.fs.File.stdout().writer(&stdout_buf);
+    const out = &stdout.interface;
+
+    // The real-time budget of a single sample.
+    const ns_budget: f64 = @as(f64, std.time.ns_per_s) / Config.sample_rate_as(f64);
+    var block_buf: [MAX_BLOCK]f32 = undefined;
+
+    try out.writeAll("node,block,ns_per_sample,voices_per_core\n");
+    for (cases) |case| {
+        if (!std.mem.startsWith(u8, case.name, filter)) continue;
+        var block: usize = MIN_BLOCK;
+        while (block <= MAX_BLOCK) : (block *= 2) {
+            // A fresh graph for every block size, so state (e.g. a decayed string) doesn't carry over.
+            _ = arena.reset(.retain_capacity);
+            const stream = try case.setup(arena.allocator());
+            _ = try measure(stream, block_buf[0..block], MAX_BLOCK); // warm up caches and branch predictors
+
+            const elapsed, const done = try measure(stream, block_buf[0..block], total);
+            const ns_per_sample = @as(f64, @floatFromInt(elapsed)) / @as(f64, @floatFromInt(done));
+            try out.print("{s},{d},{d:.3},{d:.1}\n", .{ case.name, block, ns_per_sample, ns_budget / ns_per_sample });
+            try out.flush();
+        }
+    }
+}
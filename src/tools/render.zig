@@ -0,0 +1,86 @@
+// Bounces an example's graph to a file or stdout without an audio device.
+// Built by `zig build render -Dexample=<name> -- [options]`; the example must expose `pub fn graph`.
+const std = @import("std");
+
+const Zynth = @import("zynth");
+const Render = Zynth.Render;
+const Config = Zynth.Config;
+const Example = @import("example");
+
+const usage =
+    \\usage: render [options]
+    \\  -o, --out <path>      output file, '-' for stdout (default: out.wav)
+    \\  -f, --format wav|raw  container; raw is headerless little-endian f32 (default: wav)
+    \\  -s, --secs <secs>     stop after this many seconds (default: until the graph stops)
+    \\  -b, --block <frames>  frames pulled per read (default: 512)
+    \\  -r, --rate <hz>       sample rate to render at (default: 44100)
+    \\
+;
+
+fn fail(comptime fmt: []const u8, args: anytype) noreturn {
+    std.debug.print(fmt ++ "\n" ++ usage, args);
+    std.process.exit(1);
+}
+
+pub fn main() !void {
+    const c_alloc = std.heap.c_allocator;
+    var arena = std.heap.ArenaAllocator.init(c_alloc);
+    defer arena.deinit();
+    const a = arena.allocator();
+
+    var out_path: []const u8 = "out.wav";
+    var opts = Render.Options {};
+    var block_size: u32 = 512;
+    var secs_opt: ?f64 = null;
+
+    const args = try std.process.argsAlloc(a);
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "-h") or std.mem.eql(u8, arg, "--help")) {
+            std.debug.print(usage, .{});
+            return;
+        }
+        if (i + 1 >= args.len) fail("missing value for '{s}'", .{arg});
+        const val = args[i + 1];
+        i += 1;
+        if (std.mem.eql(u8, arg, "-o") or std.mem.eql(u8, arg, "--out")) {
+            out_path = val;
+        } else if (std.mem.eql(u8, arg, "-f") or std.mem.eql(u8, arg, "--format")) {
+            opts.format = std.meta.stringToEnum(Render.Format, val) orelse fail("unknown format '{s}'", .{val});
+        } else if (std.mem.eql(u8, arg, "-s") or std.mem.eql(u8, arg, "--secs")) {
+            secs_opt = std.fmt.parseFloat(f64, val) catch fail("invalid duration '{s}'", .{val});
+        } else if (std.mem.eql(u8, arg, "-b") or std.mem.eql(u8, arg, "--block")) {
+            block_size = std.fmt.parseInt(u32, val, 10) catch fail("invalid block size '{s}'", .{val});
+            if (block_size == 0) fail("block size must be positive", .{});
+        } else if (std.mem.eql(u8, arg, "-r") or std.mem.eql(u8, arg, "--rate")) {
+            Config.sample_rate = std.fmt.parseInt(u32, val, 10) catch fail("invalid sample rate '{s}'", .{val});
+            if (Config.sample_rate == 0 or Config.sample_rate > Config.MAX_SAMPLE_RATE) fail("sample rate must be within 1..{d}", .{Config.MAX_SAMPLE_RATE});
+        } else {
+            fail("unknown option '{s}'", .{arg});
+        }
+    }
+
+    // Only now that the rate is final: the graph and the frame budget are both in samples.
+    if (secs_opt) |secs| opts.max_frames = @as(u64, @intFromFloat(secs * Config.sample_rate_as(f64)));
+
+    const to_stdout = std.mem.eql(u8, out_path, "-");
+    const file = if (to_stdout) std.fs.File.stdout() else try std.fs.cwd().createFile(out_path, .{});
+    defer if (!to_stdout) file.close();
+
+    var write_buf: [64 * 1024]u8 = undefined;
+    var file_writer = file.writer(&write_buf);
+
+    const block = try a.alloc(f32, block_size * Config.CHANNELS);
+    const stats = try Render.render(try Example.graph(a), block, &file_writer.interface, opts);
+    // The length was unknown when the header went out unless the duration was capped.
+    if (opts.format == .wav and !to_stdout and (opts.max_frames == null or opts.max_frames.? != stats.frames)) {
+        try Render.patch_wav_header(file, stats.frames);
+    }
+
+    std.debug.print("rendered {d:.3}s in {d:.3}s ({d:.1}x real time)\n", .{
+        stats.secs(),
+        @as(f64, @floatFromInt(stats.elapsed_ns)) / std.time.ns_per_s,
+        stats.realtime_factor(),
+    });
+}
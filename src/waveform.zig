@@ -4,6 +4,7 @@ const math = std.math;
 const Streamer = @import("streamer.zig");
 const Envelop = @import("envelop.zig");
 const Config = @import("config.zig");
+const Noise = @import("noise.zig");
 const Waveform = @This();
 
 pub const Shape = enum {
@@ -42,103 +43,299 @@ pub const Shape = enum {
             .Square => square_f32,
         };
     }
+
+    // Band-limited versions of the family above. The naive shapes jump (or turn) instantly, which puts
+    // energy above Nyquist that folds back as aliasing. These subtract a polynomial approximation of
+    // that excess around each discontinuity: PolyBLEP for steps, PolyBLAMP for kinks.
+    // `dt` is the phase advance per sample (frequency / sample rate), and must be below 0.5.
+    pub fn sine_bl_f32(time: f64, dt: f64) f32 {
+        _ = dt;
+        return sine_f32(time);
+    }
+
+    pub fn sawtooth_bl_f32(time: f64, dt: f64) f32 {
+        const f: f64 = time - @floor(time);
+        return @floatCast(2 * (f - 0.5) - 2 * poly_blep(f, dt));
+    }
+
+    pub fn square_bl_f32(time: f64, dt: f64) f32 {
+        const f: f64 = time - @floor(time);
+        const h: f64 = f + 0.5 - @floor(f + 0.5);
+        const r: f64 = if (f < 0.5) 1.0 else -1.0;
+        return @floatCast(r + 2 * poly_blep(f, dt) - 2 * poly_blep(h, dt));
+    }
+
+    pub fn triangle_bl_f32(time: f64, dt: f64) f32 {
+        const f: f64 = time - @floor(time);
+        const h: f64 = f + 0.5 - @floor(f + 0.5);
+        const r = 2 * @abs(2 * (f - 0.5)) - 1;
+        // The slope flips by 8 per cycle (8*dt per sample): downwards at 0, upwards at 0.5.
+        return @floatCast(r + 8 * dt * (poly_blamp(h, dt) - poly_blamp(f, dt)));
+    }
+
+    pub fn get_band_limited_func(self: Shape) *const fn (f64, f64) f32 {
+        return switch (self) {
+            .Sine => sine_bl_f32,
+            .Sawtooth => sawtooth_bl_f32,
+            .Triangle => triangle_bl_f32,
+            .Square => square_bl_f32,
+        };
+    }
 };
 
+// Residual of a band-limited unit step at phase 0, for a sample at phase `f` in [0, 1).
+// Only the samples within `dt` of the step are affected.
+fn poly_blep(f: f64, dt: f64) f64 {
+    if (f < dt) {
+        const x = 1 - f / dt;
+        return -0.5 * x * x;
+    } else if (f > 1 - dt) {
+        const x = 1 - (1 - f) / dt;
+        return 0.5 * x * x;
+    }
+    return 0;
+}
+
+// Residual of a band-limited unit slope change (per sample) at phase 0: the integral of `poly_blep`.
+fn poly_blamp(f: f64, dt: f64) f64 {
+    if (f < dt) {
+        const x = 1 - f / dt;
+        return x * x * x / 6;
+    } else if (f > 1 - dt) {
+        const x = 1 - (1 - f) / dt;
+        return x * x * x / 6;
+    }
+    return 0;
+}
+
 
 
+// Vectorized versions of the naive shapes, specialized at comptime so a whole block runs without
+// a function pointer or a branch per sample. `eval` takes `N` phases in [0, 1) at once.
+pub const Kernel = struct {
+    // 8 phases per step, or 16 where the target has 512-bit vectors.
+    pub const LEN = @max(8, Streamer.VEC_LEN);
+
+    // sin(2πx) for x in [-0.25, 0.25], as an odd degree 7 polynomial fitted with the Remez algorithm.
+    // The polynomial's own error is below 5.9e-7 (-124 dB); evaluated in f32 it stays within 1e-6
+    // of `@sin` (-120 dB), under the noise floor of a 16-bit output.
+    const SIN_C1: f32 = 6.283164044302505;
+    const SIN_C3: f32 = -41.337142371122624;
+    const SIN_C5: f32 = 81.34076888869937;
+    const SIN_C7: f32 = -70.99343328277975;
+
+    // sin(2πf) for f in [0, 1), with the error bound above.
+    pub fn sin_2pi(comptime N: usize, f: @Vector(N, f32)) @Vector(N, f32) {
+        const V = @Vector(N, f32);
+        const half: V = @splat(0.5);
+        const quarter: V = @splat(0.25);
+        // sin(2πf) = -sin(2πx) with x = f - 0.5 in [-0.5, 0.5);
+        // then fold |x| > 0.25 back with sin(π - θ) = sin(θ).
+        var x = f - half;
+        const sign = @select(f32, x < @as(V, @splat(0)), -half, half);
+        x = @select(f32, @abs(x) > quarter, sign - x, x);
+        const x2 = x * x;
+        const p = x * (@as(V, @splat(SIN_C1)) + x2 * (@as(V, @splat(SIN_C3)) + x2 * (@as(V, @splat(SIN_C5)) + x2 * @as(V, @splat(SIN_C7)))));
+        return -p;
+    }
+
+    pub fn eval(comptime shape: Shape, comptime N: usize, f: @Vector(N, f32)) @Vector(N, f32) {
+        const V = @Vector(N, f32);
+        const one: V = @splat(1);
+        return switch (shape) {
+            .Sine => sin_2pi(N, f),
+            .Triangle => @as(V, @splat(4)) * @abs(f - @as(V, @splat(0.5))) - one,
+            .Sawtooth => @as(V, @splat(2)) * f - one,
+            .Square => @select(f32, f < @as(V, @splat(0.5)), one, -one),
+        };
+    }
+};
+
 pub fn calculate_advance(sample_rate: u32, frequency: f64) f64 {
         return (1.0 / (@as(f64, @floatFromInt(sample_rate)) / frequency));
 }
 
+// Oscillator phases are u32 fixed point fractions of a cycle that wrap around on overflow.
+// Unlike an ever-growing float time, they keep the same resolution (sample_rate / 2^32 Hz) for as long
+// as a voice plays, and two oscillators at the same frequency stay locked together exactly.
+pub const PHASE_ONE: f64 = 1 << 32;
+
+// The phase advance per sample at the current sample rate, capped just below Nyquist either way.
+// A negative frequency (FM, or a pitch envelope going below 0) gives the two's complement of the
+// increment, so the wrapping phase runs backwards.
+pub fn phase_increment(freq: f64) u32 {
+    const max: f64 = (1 << 31) - 1;
+    const inc = std.math.clamp(freq / Config.sample_rate_as(f64) * PHASE_ONE, -max, max);
+    return @bitCast(@as(i32, @intFromFloat(inc)));
+}
+
+// How far an increment moves the phase, whichever way it runs.
+pub fn increment_magnitude(inc: u32) u32 {
+    return @abs(@as(i32, @bitCast(inc)));
+}
+
+// The phase as a fraction of a cycle in [0, 1). Only the top 24 bits are kept, which f32 holds exactly.
+pub fn phase_unit(comptime N: usize, phase: @Vector(N, u32)) @Vector(N, f32) {
+    const top: @Vector(N, f32) = @floatFromInt(phase >> @splat(8));
+    return top * @as(@Vector(N, f32), @splat(1.0 / @as(f32, 1 << 24)));
+}
+
+fn phase_f64(phase: u32) f64 {
+    return @as(f64, @floatFromInt(phase)) / PHASE_ONE;
+}
+
 pub const Simple = struct {
-    advance: f64,
-    time: f64,
+    phase: u32,
+    inc: u32,
     amplitude: f32,
     frequency: f64,
     shape: Shape,
+    // Use the PolyBLEP shapes (`Shape.get_band_limited_func`), at a small extra cost per sample.
+    band_limited: bool = false,
+
+    pub const silence = Simple { .amplitude = 0, .frequency = 440, .inc = 0, .phase = 0, .shape = .Sine };
+
+    fn render(self: *Simple, out: []f32, gain: f32, comptime add: bool) void {
+        if (self.band_limited) {
+            const amp = self.amplitude * gain;
+            const func = self.shape.get_band_limited_func();
+            const dt = phase_f64(increment_magnitude(self.inc));
+            for (out) |*x| {
+                self.phase +%= self.inc;
+                const y = func(phase_f64(self.phase), dt) * amp;
+                if (add) x.* += y else x.* = y;
+            }
+        } else switch (self.shape) {
+            inline else => |shape| self.render_kernel(shape, out, gain, add),
+        }
+    }
 
-    pub const silence = Simple.init(0, 440, .Sine);
-
-    fn read(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
-        const self: *Simple = @alignCast(@ptrCast(ptr));
-        const func = self.shape.get_wave_func();
-        for (0..frames.len) |i| {
-            self.time += self.advance;
-            frames[i] = func(self.time) * self.amplitude;
+    fn render_kernel(self: *Simple, comptime shape: Shape, out: []f32, gain: f32, comptime add: bool) void {
+        const N = Kernel.LEN;
+        const U = @Vector(N, u32);
+        const amp: @Vector(N, f32) = @splat(self.amplitude * gain);
+        // Offsets of the next N samples from `phase`; the first sample is one increment ahead.
+        const steps = (std.simd.iota(u32, N) + @as(U, @splat(1))) *% @as(U, @splat(self.inc));
+        var i: usize = 0;
+        while (i < out.len) {
+            const n = @min(N, out.len - i);
+            const y: [N]f32 = Kernel.eval(shape, N, phase_unit(N, @as(U, @splat(self.phase)) +% steps)) * amp;
+            for (out[i..][0..n], y[0..n]) |*x, v| {
+                if (add) x.* += v else x.* = v;
+            }
+            self.phase +%= self.inc *% @as(u32, @intCast(n));
+            i += n;
         }
+    }
+
+    pub fn read(self: *Simple, frames: []f32) struct { u32, Streamer.Status } {
+        self.render(frames, 1, false);
         return .{ @intCast(frames.len), Streamer.Status.Continue };
     }
 
-    fn reset(ptr: *anyopaque) bool {
-        const self: *Simple = @alignCast(@ptrCast(ptr));
-        self.time = 0;
+    pub fn read_add(self: *Simple, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+        self.render(out, gain, true);
+        return .{ @intCast(out.len), Streamer.Status.Continue };
+    }
+
+    pub fn reset(self: *Simple) bool {
+        self.phase = 0;
         return true;
     }
 
     pub fn streamer(self: *Simple) Streamer {
-        return .{
-            .ptr = @ptrCast(self),
-            .vtable = .{
-                .read = read,
-                .reset = reset,
-            },
-        };
+        return Streamer.make(Simple, self);
+    }
+
+    // Takes effect from the next sample, without a discontinuity.
+    pub fn set_frequency(self: *Simple, freq: f64) void {
+        self.frequency = freq;
+        self.inc = phase_increment(freq);
     }
 
     pub fn init(amp: f32, freq: f64, shape: Shape) Simple {
         return .{
             .amplitude = amp,
             .frequency = freq,
-            .advance = calculate_advance(Config.SAMPLE_RATE, freq),
-            .time    = 0,
+            .inc = phase_increment(freq),
+            .phase = 0,
             .shape = shape,
         };
     }
+
+    pub fn init_band_limited(amp: f32, freq: f64, shape: Shape) Simple {
+        var simple = init(amp, freq, shape);
+        simple.band_limited = true;
+        return simple;
+    }
 };
 pub const FreqEnvelop = struct {
-    time: f64, // time in secs, different from the `time` above
-    wave_time: f64,
+    phase: u32,
     amplitude: f32,
     le: Envelop.LinearEnvelop(f64, f64, .dynamic),
+    cursor: Envelop.LinearEnvelop(f64, f64, .dynamic).Cursor = .{},
     shape: Shape,
+    band_limited: bool = false, // see `Simple.band_limited`
+
+    pub fn read(self: *FreqEnvelop, frames: []f32) struct { u32, Streamer.Status } {
+        if (self.band_limited) return self.read_band_limited(frames);
+        return switch (self.shape) {
+            inline else => |shape| self.read_kernel(shape, frames),
+        };
+    }
+
+    // The frequency can change every sample, so the phases are accumulated one by one,
+    // but the frequencies come from the envelop cursor and the waveform is evaluated `Kernel.LEN` at a time.
+    fn read_kernel(self: *FreqEnvelop, comptime shape: Shape, frames: []f32) struct { u32, Streamer.Status } {
+        const N = Kernel.LEN;
+        const amp: @Vector(N, f32) = @splat(self.amplitude);
+        var i: usize = 0;
+        while (i < frames.len) {
+            var freqs: [N]f64 = undefined;
+            const n, const status = self.cursor.run(&self.le, freqs[0..@min(N, frames.len - i)], .write);
+            var phases = [_]u32 {0} ** N;
+            for (freqs[0..n], phases[0..n]) |freq, *phase| {
+                self.phase +%= phase_increment(freq);
+                phase.* = self.phase;
+            }
+            const y: [N]f32 = Kernel.eval(shape, N, phase_unit(N, phases)) * amp;
+            @memcpy(frames[i..][0..n], y[0..n]);
+            i += n;
+            if (status == .Stop) return .{ @intCast(i), .Stop };
+        }
+        return .{ @intCast(frames.len), Streamer.Status.Continue };
+    }
 
-    fn read(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
-        const self: *FreqEnvelop = @alignCast(@ptrCast(ptr));
-        const func = self.shape.get_wave_func();
-        for (0..frames.len) |i| {
-            self.time += 1.0/@as(comptime_float, @floatFromInt(Config.SAMPLE_RATE));
-            const freq, const status = self.le.get(self.time);
-            self.wave_time += calculate_advance(Config.SAMPLE_RATE, freq);
-            frames[i] = func(self.wave_time) * self.amplitude;
-            if (status == .Stop) {
-                return .{ @intCast(i), .Stop };
+    fn read_band_limited(self: *FreqEnvelop, frames: []f32) struct { u32, Streamer.Status } {
+        const func = self.shape.get_band_limited_func();
+        var i: usize = 0;
+        while (i < frames.len) {
+            var freqs: [Kernel.LEN]f64 = undefined;
+            const n, const status = self.cursor.run(&self.le, freqs[0..@min(Kernel.LEN, frames.len - i)], .write);
+            for (freqs[0..n], frames[i..][0..n]) |freq, *x| {
+                const inc = phase_increment(freq);
+                self.phase +%= inc;
+                x.* = func(phase_f64(self.phase), phase_f64(increment_magnitude(inc))) * self.amplitude;
             }
-        } else {
-            return .{ @intCast(frames.len), Streamer.Status.Continue };
+            i += n;
+            if (status == .Stop) return .{ @intCast(i), .Stop };
         }
+        return .{ @intCast(frames.len), Streamer.Status.Continue };
     }
 
-    fn reset(ptr: *anyopaque) bool {
-        const self: *FreqEnvelop = @alignCast(@ptrCast(ptr));
-        self.time = 0;
-        self.wave_time = 0;
+    pub fn reset(self: *FreqEnvelop) bool {
+        self.cursor = .{};
+        self.phase = 0;
         return true;
     }
 
     pub fn streamer(self: *FreqEnvelop) Streamer {
-        return .{
-            .ptr = @ptrCast(self),
-            .vtable = .{
-                .read = read,
-                .reset = reset,
-            },
-        };
+        return Streamer.make(FreqEnvelop, self);
     }
 
     pub fn init(amp: f32, freq_le: Envelop.LinearEnvelop(f64, f64, .dynamic), shape: Shape) FreqEnvelop {
         return .{
-            .time = 0,
-            .wave_time = 0,
+            .phase = 0,
             .amplitude = amp,
             .le = freq_le,
             .shape = shape,
@@ -146,161 +343,187 @@ pub const FreqEnvelop = struct {
     }
 };
 
-pub const WhiteNoise = struct {
-    amp: f32,
-    random: std.Random,
-
-    pub fn streamer(self: *WhiteNoise) Streamer {
-        return .{
-            .ptr = @ptrCast(self),
-            .vtable = .{
-                .read = read_impl,
-                .reset = reset,
-            },
-        };
-    }
-
-   fn read(self: *WhiteNoise, frames: []f32) struct { u32, Streamer.Status } {
-        for (0..frames.len) |i| {
-            frames[i] = 2*(self.random.float(f32)-0.5) * self.amp;
-        }
-        return .{ @intCast(frames.len), .Continue };
-    }
-   fn read_impl(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
-        const self: *WhiteNoise = @alignCast(@ptrCast(ptr));
-        return self.read(frames);
-    }
-
-   fn reset(ptr: *anyopaque) bool { 
-       _ = ptr; 
-       return true;
-   }
-};
+// Kept under its old name; see `Noise` for pink and velvet noise.
+pub const WhiteNoise = Noise.White;
 
+// White noise through a one-pole low-pass with time constant `rc` seconds (cutoff 1 / (2π rc) Hz).
+// The output is scaled back up to the RMS level of the white noise, so `white.amp` sets the loudness.
 pub const BrownNoise = struct {
     white: WhiteNoise,
     rc: f32,
+    y: f32 = 0,
     pub fn streamer(self: *BrownNoise) Streamer {
-        return .{
-            .ptr = @ptrCast(self),
-            .vtable = .{
-                .read = read,
-                .reset = reset,
-            },
-        };
+        return Streamer.make(BrownNoise, self);
     }
 
-   fn read(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
-        const self: *BrownNoise = @alignCast(@ptrCast(ptr));
-        var tmp = [_]f32 {0} ** 4096;
-        std.debug.assert(tmp.len >= frames.len);
-        _ = self.white.read(tmp[0..frames.len]);
-        const dt: f32 = @as(f32, @floatFromInt(frames.len)) / Config.SAMPLE_RATE;
+   pub fn read(self: *BrownNoise, frames: []f32) struct { u32, Streamer.Status } {
+        _ = self.white.read(frames);
+        const dt: f32 = 1 / Config.sample_rate_as(f32);
         const a: f32 = dt / (self.rc + dt);
-        frames[0] = a * tmp[0];
-        for (1..frames.len) |i| {
-            frames[i] = a * tmp[i] + (1-a) * frames[i-1];
+        // A one-pole filter leaves a / (2 - a) of white noise's power.
+        const makeup = @sqrt((2 - a) / a);
+        var y = self.y;
+        for (frames) |*x| {
+            y += a * (x.* - y);
+            x.* = y * makeup;
         }
+        self.y = y;
         return .{ @intCast(frames.len), .Continue };
     }
 
-   fn reset(ptr: *anyopaque) bool { 
-       _ = ptr; 
+   pub fn reset(self: *BrownNoise) bool { 
+       self.y = 0;
        return true;
    }
 };
 
+// Karplus-Strong plucked string: a burst of noise circulating through a delay line with a low-pass in the loop.
+// The delay line is a power-of-two ring indexed by mask, just long enough for the note. The two-point average
+// in the loop delays half a sample and a first-order allpass supplies the fractional rest,
+// so the loop is exactly sample_rate / freq samples long and the note is in tune.
 pub const StringNoise = struct {
     pub const stop_epsilon: f32 = 0.00001;
-    buf: [1024]f32,
-    count: u32,
-    buf_len: u32,
+    pub const MIN_FREQ = 20;
+    pub const MAX_LEN = std.math.ceilPowerOfTwoAssert(u32, Config.MAX_SAMPLE_RATE / MIN_FREQ + 2);
+    buf: [MAX_LEN]f32,
+    mask: u32,
+    delay: u32, // whole samples in the loop
+    w: u32 = 0,
+    allpass: f32,
+    prev: f32 = 0,
+    ap_x: f32 = 0,
+    ap_y: f32 = 0,
+    // Sum of squares of the samples in the loop, kept up to date as they are replaced.
+    energy: f64 = 0,
+
+    // Copied into the loop on `reset`, wrapping if it is shorter than the loop.
+    excitation: []const f32,
+    excitation_offset: u32,
 
     feedback: f32,
     stop_feedback: f32,
     amp: f32,
 
-    random: std.Random,
-    
     stopped: bool = false,
-    t: ?struct {dura: f32, elapse: f32},
-    pub fn init(amp: f32, freq: f64, random: std.Random, dura_or_null: ?f32) StringNoise {
+    duration: ?u64, // samples until `stop`
+    elapsed: u64 = 0,
+
+    // Plucked with white noise from a table shared by every string, starting at a point that depends on `freq`
+    // so that strings played together aren't correlated.
+    pub fn init(amp: f32, freq: f64, dura_or_null: ?f32) StringNoise {
+        excitation_noise_once.call();
+        const offset: u32 = @truncate(@as(u64, @intFromFloat(freq * 1000)) *% 0x9E3779B9);
+        return init_at(amp, freq, &excitation_noise, offset, dura_or_null);
+    }
+
+    pub fn init_excitation(amp: f32, freq: f64, excitation: []const f32, dura_or_null: ?f32) StringNoise {
+        return init_at(amp, freq, excitation, 0, dura_or_null);
+    }
+
+    fn init_at(amp: f32, freq: f64, excitation: []const f32, offset: u32, dura_or_null: ?f32) StringNoise {
+        std.debug.assert(excitation.len > 0);
+        // Loop length = delay + 1/2 (average) + d (allpass), with d kept in [0.1, 1.1) where the allpass is flat.
+        const period = std.math.clamp(Config.sample_rate_as(f64) / freq, 1.6, MAX_LEN);
+        const delay: u32 = @intFromFloat(@floor(period - 0.6));
+        const d = period - 0.5 - @as(f64, @floatFromInt(delay));
         var sn = StringNoise {
-            .count = 0,
-            .buf_len = @intFromFloat(Config.SAMPLE_RATE / freq),
-            .feedback = 0.99996,                       
-            .stop_feedback = 0.95,
             .buf = undefined,
+            .mask = std.math.ceilPowerOfTwoAssert(u32, delay) - 1,
+            .delay = delay,
+            .allpass = @floatCast((1 - d) / (1 + d)),
+            .excitation = excitation,
+            .excitation_offset = @intCast(offset % excitation.len),
+            .feedback = 0.99996,
+            .stop_feedback = 0.95,
             .amp = amp,
-            .random = random,
-            .t = if (dura_or_null) |dura| .{.dura = dura, .elapse = 0} else null,
+            .duration = if (dura_or_null) |dura| @as(u64, @intFromFloat(dura * Config.sample_rate_as(f32))) else null,
         };
-        std.debug.assert(sn.buf_len <= 1024);
-        for (0..sn.buf_len) |i| {
-            // fit a single cycle into the buffer
-            // var t: f32 = @as(f32, @floatFromInt(i)) / @as(f32, @floatFromInt(sn.buf_len));
-            // string->buf[i] = ma_waveform_square_f32(t, 1);
-            // string->buf[i] = ma_waveform_sawtooth_f32(t, 1);
-            sn.buf[i] = (sn.random.float(f32) - 0.5) * 2;
-        }
+        _ = sn.reset();
         return sn;
     }
 
-    fn read(ptr: *anyopaque, frames: []f32) struct { u32, Streamer.Status } {
-        const self: *StringNoise = @alignCast(@ptrCast(ptr));
-        for (0..frames.len) |frame_i| {
-            frames[frame_i] = self.buf[self.count] * self.amp;
-            if (self.t) |*t| {
-                t.elapse += 1.0 / @as(f32, @floatFromInt(Config.SAMPLE_RATE));
-                if (t.elapse >= t.dura) self.stopped = true;
-            }
-            const range = 1;
-            var sum: f32 = 0;
-            const len: i32 = @intCast(self.buf_len);
-            var i: i32 = -range;
-            while (i <= range) : (i += 1) {
-                const idx = @mod(@as(i32, @intCast(self.count)) + i, len);
-                sum += self.buf[@intCast(idx)];
+    fn run(self: *StringNoise, out: []f32, feedback: f32) void {
+        const c = self.allpass;
+        var w = self.w;
+        var prev = self.prev;
+        var ap_x = self.ap_x;
+        var ap_y = self.ap_y;
+        var energy = self.energy;
+        for (out) |*o| {
+            const x = self.buf[(w -% self.delay) & self.mask];
+            const avg = 0.5 * (x + prev);
+            prev = x;
+            ap_y = c * (avg - ap_y) + ap_x;
+            ap_x = avg;
+            const v = ap_y * feedback;
+            self.buf[w & self.mask] = v;
+            // `x` left the loop and `v` entered it.
+            energy += @as(f64, v * v) - @as(f64, x * x);
+            w +%= 1;
+            o.* = x * self.amp;
+        }
+        self.w = w;
+        self.prev = prev;
+        self.ap_x = ap_x;
+        self.ap_y = ap_y;
+        self.energy = @max(energy, 0);
+    }
+
+    pub fn read(self: *StringNoise, frames: []f32) struct { u32, Streamer.Status } {
+        var done: usize = 0;
+        if (!self.stopped) {
+            done = if (self.duration) |d| @intCast(@min(frames.len, d -| self.elapsed)) else frames.len;
+            self.run(frames[0..done], self.feedback);
+            self.elapsed += done;
+            if (self.duration) |d| {
+                if (self.elapsed >= d) self.stopped = true;
             }
-            self.buf[self.count] = sum / (range * 2 + 1) * if (self.stopped) self.stop_feedback else self.feedback;
-            self.count = (self.count + 1) % self.buf_len;
         }
-        var sum: f32 = 0;
-        for (frames) |f|
-            sum += @abs(f);
-        const avg = sum / @as(f32, @floatFromInt(frames.len));
-        if (avg < stop_epsilon) return .{ @intCast(frames.len), .Stop };
+        self.run(frames[done..], self.stop_feedback);
+
+        const mean_square = self.energy / @as(f64, @floatFromInt(self.delay)) * @as(f64, self.amp * self.amp);
+        if (mean_square < @as(f64, stop_epsilon * stop_epsilon)) return .{ @intCast(frames.len), .Stop };
         return .{ @intCast(frames.len), .Continue };
     }
 
-    fn reset(ptr: *anyopaque) bool {
-        const self: *StringNoise = @alignCast(@ptrCast(ptr));
-        for (0..self.buf_len) |i| {
-            self.buf[i] = (self.random.float(f32) - 0.5) * 2;
+    // Replays the excitation, so plucking again costs a copy and no random numbers.
+    pub fn reset(self: *StringNoise) bool {
+        var energy: f64 = 0;
+        var src: usize = self.excitation_offset;
+        // The loop is the `delay` samples before `w`.
+        self.w = 0;
+        for (0..self.delay) |k| {
+            const x = self.excitation[src];
+            self.buf[(self.w -% self.delay +% @as(u32, @intCast(k))) & self.mask] = x;
+            energy += @as(f64, x * x);
+            src += 1;
+            if (src == self.excitation.len) src = 0;
         }
+        self.energy = energy;
+        self.prev = 0;
+        self.ap_x = 0;
+        self.ap_y = 0;
         self.stopped = false;
-        self.count = 0;
-        if (self.t) |*t| {
-            t.elapse = 0;
-        }
+        self.elapsed = 0;
         return true;
     }
 
-    fn stop(ptr: *anyopaque) bool {
-        const self: *StringNoise = @alignCast(@ptrCast(ptr));
+    pub fn stop(self: *StringNoise) bool {
         self.stopped = true;
         return true;
     }
 
     pub fn streamer(self: *StringNoise) Streamer {
-        return .{
-            .ptr = @ptrCast(self),
-            .vtable = .{
-                .read = read,
-                .reset = reset,
-                .stop = stop,
-            }
-        };
+        return Streamer.make(StringNoise, self);
     }
 
 };
+
+var excitation_noise: [StringNoise.MAX_LEN]f32 = undefined;
+var excitation_noise_once = std.once(build_excitation_noise);
+
+fn build_excitation_noise() void {
+    var streams = Noise.Streams.init(0);
+    var rng = streams.next();
+    rng.fill(&excitation_noise, 1, .write);
+}
@@ -0,0 +1,222 @@
+//! Band-limited wavetable oscillator.
+//! Every waveform is stored as a set of single-cycle tables, one per octave ("mip levels"): level 0 keeps
+//! all `HARMONICS` harmonics, and each next level keeps half as many. The oscillator reads the level whose
+//! highest harmonic still falls below Nyquist at its pitch, so it never aliases, and a sample costs one
+//! linear interpolation instead of a `@sin` or a function pointer call.
+const std = @import("std");
+
+const Streamer = @import("streamer.zig");
+const Config = @import("config.zig");
+const Waveform = @import("waveform.zig");
+const Shape = Waveform.Shape;
+
+const Wavetable = @This();
+
+pub const TABLE_LEN_LOG2 = 11;
+pub const TABLE_LEN = 1 << TABLE_LEN_LOG2;
+pub const HARMONICS = TABLE_LEN / 2;
+pub const LEVELS = TABLE_LEN_LOG2; // HARMONICS down to 1 harmonic
+
+// The phase is the same u32 fixed point fraction of a cycle as `Waveform.Simple`'s. Its top bits index the table
+// and the rest interpolate.
+const FRAC_BITS = 32 - TABLE_LEN_LOG2;
+const FRAC_SCALE: f32 = 1.0 / @as(f32, 1 << FRAC_BITS);
+
+// Each level has one extra sample, a copy of the first, so interpolation never wraps.
+pub const Level = [TABLE_LEN + 1]f32;
+pub const Table = [LEVELS]Level;
+
+// Amplitudes of a Fourier series, indexed by harmonic: x(t) = Σ cos[n] cos(2πnt) + sin[n] sin(2πnt).
+// Index 0 of `cos` is the DC offset.
+pub const Spectrum = struct {
+    cos: [HARMONICS + 1]f32 = [_]f32 {0} ** (HARMONICS + 1),
+    sin: [HARMONICS + 1]f32 = [_]f32 {0} ** (HARMONICS + 1),
+};
+
+var shape_tables: [@typeInfo(Shape).@"enum".fields.len]Table = undefined;
+var shape_tables_once = std.once(build_shape_tables);
+var unit_sine: [TABLE_LEN]f32 = undefined;
+var unit_sine_once = std.once(build_unit_sine);
+
+fn build_unit_sine() void {
+    for (&unit_sine, 0..) |*s, i| {
+        s.* = @floatCast(@sin(2 * std.math.pi * @as(f64, @floatFromInt(i)) / TABLE_LEN));
+    }
+}
+
+// The series of the naive shapes in `Waveform.Shape`, so both oscillators have the same phase and polarity.
+pub fn shape_spectrum(shape: Shape) Spectrum {
+    var spectrum = Spectrum {};
+    switch (shape) {
+        .Sine => spectrum.sin[1] = 1,
+        .Sawtooth => for (1..HARMONICS + 1) |n| {
+            spectrum.sin[n] = -2 / (std.math.pi * @as(f32, @floatFromInt(n)));
+        },
+        .Square => for (1..HARMONICS + 1) |n| {
+            if (n % 2 == 1) spectrum.sin[n] = 4 / (std.math.pi * @as(f32, @floatFromInt(n)));
+        },
+        .Triangle => for (1..HARMONICS + 1) |n| {
+            const nf: f32 = @floatFromInt(n);
+            if (n % 2 == 1) spectrum.cos[n] = 8 / (std.math.pi * std.math.pi * nf * nf);
+        },
+    }
+    return spectrum;
+}
+
+fn build_shape_tables() void {
+    for (&shape_tables, 0..) |*table, i| {
+        const spectrum = shape_spectrum(@enumFromInt(i));
+        synthesize(table, &spectrum);
+    }
+}
+
+// Fills every level of `table` from `spectrum`. The levels are built from the top down, each one adding
+// its extra harmonics to the level above it, so the whole table costs `HARMONICS` passes over one level.
+pub fn synthesize(table: *Table, spectrum: *const Spectrum) void {
+    unit_sine_once.call();
+    var acc: [TABLE_LEN]f32 = undefined;
+    @memset(&acc, spectrum.cos[0]);
+    var done: usize = 0;
+    var level: usize = LEVELS;
+    while (level > 0) {
+        level -= 1;
+        const harmonics = @as(usize, HARMONICS) >> @intCast(level);
+        for (done + 1..harmonics + 1) |n| {
+            const c = spectrum.cos[n];
+            const s = spectrum.sin[n];
+            if (c == 0 and s == 0) continue;
+            // sin(2πni/L) and cos(2πni/L) are exact lookups into one cycle of sine.
+            for (&acc, 0..) |*x, i| {
+                const j = n * i;
+                x.* += s * unit_sine[j % TABLE_LEN] + c * unit_sine[(j + TABLE_LEN / 4) % TABLE_LEN];
+            }
+        }
+        done = harmonics;
+        @memcpy(table[level][0..TABLE_LEN], &acc);
+        table[level][TABLE_LEN] = acc[0];
+    }
+}
+
+// Analyses one cycle of any length and builds its band-limited table, e.g. for a cycle loaded from a file.
+// This is a plain DFT, so call it while setting up a patch, not from the audio thread.
+pub fn from_cycle(a: std.mem.Allocator, cycle: []const f32) !*Table {
+    std.debug.assert(cycle.len > 0);
+    const spectrum = try a.create(Spectrum);
+    defer a.destroy(spectrum);
+    spectrum.* = .{};
+    const len: f64 = @floatFromInt(cycle.len);
+    const top = @min(HARMONICS, cycle.len / 2);
+    for (0..top + 1) |n| {
+        var re: f64 = 0;
+        var im: f64 = 0;
+        for (cycle, 0..) |x, i| {
+            const w = 2 * std.math.pi * @as(f64, @floatFromInt(n * i % cycle.len)) / len;
+            re += @as(f64, x) * @cos(w);
+            im += @as(f64, x) * @sin(w);
+        }
+        const scale: f64 = if (n == 0) 1 / len else 2 / len;
+        spectrum.cos[n] = @floatCast(re * scale);
+        spectrum.sin[n] = @floatCast(im * scale);
+    }
+    const table = try a.create(Table);
+    synthesize(table, spectrum);
+    return table;
+}
+
+pub fn shape_table(shape: Shape) *const Table {
+    shape_tables_once.call();
+    return &shape_tables[@intFromEnum(shape)];
+}
+
+// The first level whose top harmonic stays below Nyquist when the phase advances by `inc`.
+// Level 0 is only alias-free up to `inc` = 2^(32 - TABLE_LEN_LOG2), i.e. sample_rate / TABLE_LEN Hz.
+pub fn level_for(inc: u32) u32 {
+    if (inc <= 1 << FRAC_BITS) return 0;
+    const ceil_log2: u32 = 32 - @clz(inc - 1);
+    return @min(LEVELS - 1, ceil_log2 - FRAC_BITS);
+}
+
+// A drop-in replacement for `Waveform.Simple`.
+pub const Oscillator = struct {
+    table: *const Table,
+    level: *const Level,
+    phase: u32 = 0,
+    inc: u32,
+    amplitude: f32,
+    frequency: f64,
+
+    pub fn init(amp: f32, freq: f64, shape: Shape) Oscillator {
+        return init_table(amp, freq, shape_table(shape));
+    }
+
+    pub fn init_table(amp: f32, freq: f64, table: *const Table) Oscillator {
+        const inc = Waveform.phase_increment(freq);
+        return .{
+            .table = table,
+            .level = &table[level_for(Waveform.increment_magnitude(inc))],
+            .inc = inc,
+            .amplitude = amp,
+            .frequency = freq,
+        };
+    }
+
+    pub fn set_frequency(self: *Oscillator, freq: f64) void {
+        self.frequency = freq;
+        self.inc = Waveform.phase_increment(freq);
+        self.level = &self.table[level_for(Waveform.increment_magnitude(self.inc))];
+    }
+
+    fn render(self: *Oscillator, out: []f32, gain: f32, comptime add: bool) void {
+        const N = Streamer.VEC_LEN;
+        const U = @Vector(N, u32);
+        const amp: Streamer.Vec = @splat(self.amplitude * gain);
+        // Like `Waveform.Simple`, the phase advances before each sample, so the first one is one increment ahead.
+        const steps: U = (std.simd.iota(u32, N) + @as(U, @splat(1))) *% @as(U, @splat(self.inc));
+        const level = self.level;
+        var i: usize = 0;
+        while (i + N <= out.len) : (i += N) {
+            const phases = @as(U, @splat(self.phase)) +% steps;
+            const idx = phases >> @splat(FRAC_BITS);
+            const frac = @as(Streamer.Vec, @floatFromInt(phases & @as(U, @splat((1 << FRAC_BITS) - 1)))) * @as(Streamer.Vec, @splat(FRAC_SCALE));
+            var lo: Streamer.Vec = undefined;
+            var hi: Streamer.Vec = undefined;
+            inline for (0..N) |k| {
+                lo[k] = level[idx[k]];
+                hi[k] = level[idx[k] + 1];
+            }
+            const y = (lo + (hi - lo) * frac) * amp;
+            if (add) {
+                out[i..][0..N].* = @as(Streamer.Vec, out[i..][0..N].*) + y;
+            } else {
+                out[i..][0..N].* = y;
+            }
+            self.phase +%= self.inc *% N;
+        }
+        while (i < out.len) : (i += 1) {
+            self.phase +%= self.inc;
+            const idx = self.phase >> FRAC_BITS;
+            const frac = @as(f32, @floatFromInt(self.phase & ((1 << FRAC_BITS) - 1))) * FRAC_SCALE;
+            const y = (level[idx] + (level[idx + 1] - level[idx]) * frac) * amp[0];
+            if (add) out[i] += y else out[i] = y;
+        }
+    }
+
+    pub fn read(self: *Oscillator, frames: []f32) struct { u32, Streamer.Status } {
+        self.render(frames, 1, false);
+        return .{ @intCast(frames.len), .Continue };
+    }
+
+    pub fn read_add(self: *Oscillator, out: []f32, gain: f32) struct { u32, Streamer.Status } {
+        self.render(out, gain, true);
+        return .{ @intCast(out.len), .Continue };
+    }
+
+    pub fn reset(self: *Oscillator) bool {
+        self.phase = 0;
+        return true;
+    }
+
+    pub fn streamer(self: *Oscillator) Streamer {
+        return Streamer.make(Oscillator, self);
+    }
+};
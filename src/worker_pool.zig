@@ -0,0 +1,135 @@
+//! A fixed set of threads that help the audio thread render one block.
+//! The threads are spawned once and sleep on a futex between blocks; `run` wakes them,
+//! works alongside them, and returns once every task of the batch is done.
+//! Nothing is allocated and no lock is taken per block.
+const std = @import("std");
+const builtin = @import("builtin");
+const Futex = std.Thread.Futex;
+const Atomic = std.atomic.Value;
+
+const WorkerPool = @This();
+
+// Busy-wait this many rounds before sleeping. Blocks are short, so a sleeping thread
+// usually costs more in wake-up latency than it saves.
+const SPIN_LIMIT = 2000;
+
+pub const Task = *const fn (ctx: *anyopaque, task: u32) void;
+
+threads: []std.Thread,
+// Bumped by `run` to start a batch; the workers sleep on it.
+generation: Atomic(u32) = .init(0),
+// Workers that haven't finished the current batch yet; `run` sleeps on it.
+pending: Atomic(u32) = .init(0),
+// Index of the next task to hand out.
+next: Atomic(u32) = .init(0),
+quit: Atomic(bool) = .init(false),
+// Set while a batch is in flight, so a nested or concurrent `run` can tell the pool is taken.
+busy: Atomic(bool) = .init(false),
+
+// The current batch. Written by `run` before `generation` is bumped.
+task_count: u32 = 0,
+ctx: *anyopaque = undefined,
+func: Task = undefined,
+
+// Spawns `worker_count` threads. With 0 workers (or in a single threaded build), `run`
+// executes every task on the calling thread.
+pub fn init(a: std.mem.Allocator, worker_count: usize) !*WorkerPool {
+    const n = if (builtin.single_threaded) 0 else worker_count;
+    const self = try a.create(WorkerPool);
+    errdefer a.destroy(self);
+    self.* = .{ .threads = try a.alloc(std.Thread, n) };
+    errdefer a.free(self.threads);
+
+    var spawned: usize = 0;
+    errdefer {
+        self.shutdown();
+        for (self.threads[0..spawned]) |thread| thread.join();
+    }
+    for (self.threads) |*thread| {
+        thread.* = try std.Thread.spawn(.{}, worker, .{self});
+        spawned += 1;
+    }
+    return self;
+}
+
+// One worker per core, minus the audio thread.
+pub fn init_per_core(a: std.mem.Allocator) !*WorkerPool {
+    const cpus = std.Thread.getCpuCount() catch 1;
+    return init(a, cpus -| 1);
+}
+
+pub fn deinit(self: *WorkerPool, a: std.mem.Allocator) void {
+    self.shutdown();
+    for (self.threads) |thread| thread.join();
+    a.free(self.threads);
+    a.destroy(self);
+}
+
+fn shutdown(self: *WorkerPool) void {
+    self.quit.store(true, .release);
+    _ = self.generation.fetchAdd(1, .release);
+    Futex.wake(&self.generation, std.math.maxInt(u32));
+}
+
+// Calls `func(ctx, i)` for every `i` in `0..task_count`, spread over the workers and the calling thread.
+// Which thread runs a task is unspecified, so tasks must not depend on each other.
+// The pool runs one batch at a time: a `run` made while another is in flight (from inside a task, e.g. a
+// pooled `Mixer` that is a voice of another one, or from a second thread) runs its tasks serially on the
+// calling thread instead. After doing its share, the calling thread spins and then may `Futex.wait` for
+// the workers to finish theirs.
+pub fn run(self: *WorkerPool, task_count: u32, ctx: *anyopaque, func: Task) void {
+    if (self.threads.len == 0 or task_count <= 1 or self.busy.swap(true, .acquire)) {
+        for (0..task_count) |i| func(ctx, @intCast(i));
+        return;
+    }
+    defer self.busy.store(false, .release);
+    self.task_count = task_count;
+    self.ctx = ctx;
+    self.func = func;
+    self.next.store(0, .monotonic);
+    self.pending.store(@intCast(self.threads.len), .monotonic);
+    _ = self.generation.fetchAdd(1, .release);
+    Futex.wake(&self.generation, std.math.maxInt(u32));
+
+    self.work();
+
+    var spins: u32 = 0;
+    while (true) {
+        const pending = self.pending.load(.acquire);
+        if (pending == 0) break;
+        if (spins < SPIN_LIMIT) {
+            spins += 1;
+            std.atomic.spinLoopHint();
+        } else {
+            Futex.wait(&self.pending, pending);
+        }
+    }
+}
+
+fn work(self: *WorkerPool) void {
+    while (true) {
+        const task = self.next.fetchAdd(1, .monotonic);
+        if (task >= self.task_count) return;
+        self.func(self.ctx, task);
+    }
+}
+
+fn worker(self: *WorkerPool) void {
+    var seen: u32 = 0;
+    while (true) {
+        var spins: u32 = 0;
+        while (self.generation.load(.acquire) == seen) {
+            if (spins < SPIN_LIMIT) {
+                spins += 1;
+                std.atomic.spinLoopHint();
+            } else {
+                Futex.wait(&self.generation, seen);
+            }
+        }
+        seen = self.generation.load(.acquire);
+        if (self.quit.load(.acquire)) return;
+
+        self.work();
+        if (self.pending.fetchSub(1, .acq_rel) == 1) Futex.wake(&self.pending, 1);
+    }
+}
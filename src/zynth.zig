@@ -1,15 +1,28 @@
 pub const capi = @import("c");
+pub const Additive = @import("additive.zig");
 pub const Audio = @import("audio.zig");
+pub const Command = @import("command.zig");
 pub const Config = @import("config.zig");
+pub const Decoder = @import("decoder.zig");
 pub const Delay = @import("delay.zig");
+pub const DiskStream = @import("disk_stream.zig");
 pub const Envelop = @import("envelop.zig");
+pub const Filter = @import("filter.zig");
+pub const Fm = @import("fm.zig");
+pub const Graph = @import("graph.zig");
 pub const KeyBoard = @import("keyboard.zig");
 pub const Mixer = @import("mixer.zig");
 pub const Modulate = @import("modulate.zig");
+pub const Noise = @import("noise.zig");
+pub const Render = @import("render.zig");
 pub const Replay = @import("replay.zig");
+pub const Resampler = @import("resampler.zig");
 pub const RingBuffer = @import("ring_buffer.zig");
+pub const Sampler = @import("sampler.zig");
 pub const Streamer = @import("streamer.zig");
 pub const Waveform = @import("waveform.zig");
+pub const Wavetable = @import("wavetable.zig");
+pub const WorkerPool = @import("worker_pool.zig");
 // pub const CompilerRt = @import("compiler_rt.zig");
 // 
 // comptime {
@@ -19,6 +32,11 @@ pub const Waveform = @import("waveform.zig");
 
 pub const SimpleAudioCtx = Audio.SimpleAudioCtx;
 
+// Pulls every module into `zig build test`, so their `test` blocks are compiled and run.
+test {
+    std.testing.refAllDecls(@This());
+}
+
 pub const NoteDuration = enum(u8) {
     Whole = 0,
     Half = 1,